@@ -10,6 +10,14 @@
 #include "type.h"
 #include "param_list.h"
 #include "scope.h"
+#include "callgraph.h"
+#include "eval.h"
+#include "sched.h"
+#include "range.h"
+#include "unswitch.h"
+#include "memo.h"
+#include "icf.h"
+#include "outline.h"
 
 extern FILE *yyin;
 extern int yylex();
@@ -21,6 +29,9 @@ extern struct decl* parser_result;
 int typerr = 0;
 int reserr = 0;
 
+/* Code generation options, given after the output file */
+int opt_report = 0;
+
 /* Debugging flags*/
 #ifdef YYDEBUG
     int yydebug = 0;
@@ -267,6 +278,25 @@ int main(int argc, char *argv[]) {
         int pvalue;
         FILE* outfile;
 
+        for (int i = 4; i < argc; i++) {
+            if (!strcmp(argv[i], "-report")) {
+                opt_report = 1;
+            } else if (!strcmp(argv[i], "-ffunction-sections")) {
+                decl_function_sections = 1;
+            } else if (!strcmp(argv[i], "-fdata-sections")) {
+                decl_data_sections = 1;
+            } else if (!strcmp(argv[i], "-Os")) {
+                outline_enabled = 1;
+            } else if (!strcmp(argv[i], "-fmemoize")) {
+                memo_enabled = 1;
+            } else if (!strcmp(argv[i], "-export") && i + 1 < argc) {
+                callgraph_export(argv[++i]);
+            } else {
+                fprintf(stderr, "error: unknown code generation option %s\n", argv[i]);
+                exit(1);
+            }
+        }
+
         outfile = fopen(argv[3], "w+");
 
         // placing yyparse in pvalue and returning AST
@@ -287,9 +317,23 @@ int main(int argc, char *argv[]) {
                 fprintf(stderr, "type error: %i type error(s)\n", typerr);
                 exit(1);
             }
-            
-            
-            decl_codegen(parser_result, outfile);
+
+            eval_fold_program(parser_result, opt_report);
+            parser_result = callgraph_optimize(parser_result, opt_report);
+            parser_result = icf_merge_program(parser_result, opt_report);
+            unswitch_program(parser_result, opt_report);
+            range_program(parser_result, opt_report);
+
+            FILE* code = sched_begin();
+            decl_codegen(parser_result, code);
+            decl_codegen_entries(parser_result, code);
+            if (outline_enabled) { // repeated sequences are only found once everything is scheduled
+                FILE* scheduled = outline_begin();
+                sched_end(code, scheduled);
+                outline_end(scheduled, outfile, opt_report);
+            } else {
+                sched_end(code, outfile);
+            }
             int fret = fclose(outfile);
 	    if (fret) {
 	        fprintf(stderr, "file error: file not outputted\n"); 
@@ -0,0 +1,539 @@
+#include "callgraph.h"
+#include "symbol.h"
+#include "scope.h"
+#include "eval.h"
+#include <string.h>
+
+struct hash_table* callgraph_nodes = 0;
+struct hash_table* callgraph_exports = 0;
+int callgraph_has_main = 0;
+
+struct callgraph_clone *callgraph_clones = 0; // constant argument combinations seen at call sites, in program order
+int callgraph_clone_count = 0;
+int callgraph_clone_capacity = 0;
+
+void callgraph_export(const char *name)
+{ // names given with -export stay visible to C code even when a main is compiled
+    if (!callgraph_exports)
+        callgraph_exports = hash_table_create(0, 0);
+    hash_table_insert(callgraph_exports, name, (void *)name);
+}
+
+int callgraph_is_exported(const char *name)
+{
+    if (strchr(name, '.'))
+        return 0; // copies made by the compiler are only called from here
+    if (!callgraph_has_main)
+        return 1; // a unit without main is a library, everything in it may be called from C
+    if (!strcmp(name, "main"))
+        return 1;
+    return callgraph_exports && hash_table_lookup(callgraph_exports, name);
+}
+
+struct callgraph_node *callgraph_lookup(const char *name)
+{
+    if (!callgraph_nodes)
+        return 0;
+    return hash_table_lookup(callgraph_nodes, name);
+}
+
+void callgraph_visit_expr(struct expr *e)
+{ // marks everything e refers to as reachable, following calls into their bodies
+    if (!e)
+        return;
+
+    if (e->kind == EXPR_NAME || (e->kind == EXPR_CALL && e->left))
+    {
+        const char *name = e->kind == EXPR_NAME ? e->name : e->left->name;
+        struct callgraph_node *n = callgraph_lookup(name);
+        if (n && !n->reachable && (e->kind == EXPR_CALL || !e->symbol || e->symbol->kind == SYMBOL_GLOBAL))
+        {
+            n->reachable = 1;
+            callgraph_visit_expr(n->decl->value);
+            callgraph_visit_stmt(n->decl->code);
+        }
+    }
+
+    callgraph_visit_expr(e->next);
+    callgraph_visit_expr(e->left);
+    callgraph_visit_expr(e->right);
+}
+
+void callgraph_visit_stmt(struct stmt *s)
+{
+    if (!s)
+        return;
+    if (s->decl)
+        callgraph_visit_expr(s->decl->value);
+    callgraph_visit_expr(s->init_expr);
+    callgraph_visit_expr(s->expr);
+    callgraph_visit_expr(s->next_expr);
+    callgraph_visit_stmt(s->body);
+    callgraph_visit_stmt(s->else_body);
+    callgraph_visit_stmt(s->next);
+}
+
+void callgraph_collect_expr(struct expr *e)
+{ // records the arguments of every call site for constant propagation
+    if (!e)
+        return;
+
+    if (e->kind == EXPR_CALL && e->left)
+    {
+        struct callgraph_node *n = callgraph_lookup(e->left->name);
+        if (n && n->const_args)
+        {
+            struct param_list *p = n->decl->type->params;
+            struct expr *arg = e->right;
+            int i = 0;
+            n->calls++;
+            for (; p; p = p->next, i++)
+            {
+                if (!arg || (arg->kind != EXPR_INT_LITERAL && arg->kind != EXPR_BOOL_LITERAL && arg->kind != EXPR_CHAR_LITERAL))
+                {
+                    n->varying[i] = 1;
+                }
+                else if (!n->const_args[i])
+                {
+                    n->const_args[i] = arg;
+                }
+                else if (n->const_args[i]->kind != arg->kind || n->const_args[i]->literal_value != arg->literal_value)
+                {
+                    n->varying[i] = 1;
+                }
+                if (arg)
+                    arg = arg->next;
+            }
+        }
+    }
+
+    callgraph_collect_expr(e->next);
+    callgraph_collect_expr(e->left);
+    callgraph_collect_expr(e->right);
+}
+
+void callgraph_collect_stmt(struct stmt *s)
+{
+    if (!s)
+        return;
+    if (s->decl)
+        callgraph_collect_expr(s->decl->value);
+    callgraph_collect_expr(s->init_expr);
+    callgraph_collect_expr(s->expr);
+    callgraph_collect_expr(s->next_expr);
+    callgraph_collect_stmt(s->body);
+    callgraph_collect_stmt(s->else_body);
+    callgraph_collect_stmt(s->next);
+}
+
+int callgraph_expr_clobbers(struct expr *e)
+{ // registers the functions called in e may overwrite
+    if (!e)
+        return 0;
+    int mask = 0;
+    if (e->kind == EXPR_CALL && e->left)
+    {
+        struct callgraph_node *n = callgraph_lookup(e->left->name);
+        if (n && n->decl->type->kind == TYPE_FUNCTION)
+            mask = n->clobbers;
+    }
+    return mask | callgraph_expr_clobbers(e->next) | callgraph_expr_clobbers(e->left) | callgraph_expr_clobbers(e->right);
+}
+
+int callgraph_stmt_clobbers(struct stmt *s)
+{
+    if (!s)
+        return 0;
+    return (s->decl ? callgraph_expr_clobbers(s->decl->value) : 0) | callgraph_expr_clobbers(s->init_expr) | callgraph_expr_clobbers(s->expr) | callgraph_expr_clobbers(s->next_expr) | callgraph_stmt_clobbers(s->body) | callgraph_stmt_clobbers(s->else_body) | callgraph_stmt_clobbers(s->next);
+}
+
+void callgraph_close_clobbers(struct decl *program)
+{ // a function also clobbers everything the functions it calls clobber, iterated until recursion settles
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (struct decl *d = program; d; d = d->next)
+        {
+            struct callgraph_node *n = callgraph_lookup(d->name);
+            if (!n || n->decl != d || d->type->kind != TYPE_FUNCTION)
+                continue;
+            int mask = n->clobbers | callgraph_stmt_clobbers(d->code);
+            if (mask != n->clobbers)
+            {
+                n->clobbers = mask;
+                changed = 1;
+            }
+        }
+    }
+}
+
+int expr_assigns_name(struct expr *e, const char *name)
+{ // true if e writes the parameter called name
+    if (!e)
+        return 0;
+    if ((e->kind == EXPR_ASSGN || e->kind == EXPR_INCR || e->kind == EXPR_DECR) && e->left && e->left->kind == EXPR_NAME && e->left->symbol && e->left->symbol->kind == SYMBOL_PARAM && !strcmp(e->left->name, name))
+        return 1;
+    return expr_assigns_name(e->next, name) || expr_assigns_name(e->left, name) || expr_assigns_name(e->right, name);
+}
+
+int stmt_assigns_name(struct stmt *s, const char *name)
+{
+    if (!s)
+        return 0;
+    return (s->decl && expr_assigns_name(s->decl->value, name)) || expr_assigns_name(s->init_expr, name) || expr_assigns_name(s->expr, name) || expr_assigns_name(s->next_expr, name) || stmt_assigns_name(s->body, name) || stmt_assigns_name(s->else_body, name) || stmt_assigns_name(s->next, name);
+}
+
+void expr_substitute_param(struct expr *e, const char *name, struct expr *value)
+{ // turns every read of the parameter called name into a copy of the literal value
+    if (!e)
+        return;
+    if (e->kind == EXPR_NAME && e->symbol && e->symbol->kind == SYMBOL_PARAM && !strcmp(e->name, name))
+    {
+        e->kind = value->kind;
+        e->literal_value = value->literal_value;
+        e->symbol = 0;
+    }
+    expr_substitute_param(e->next, name, value);
+    expr_substitute_param(e->left, name, value);
+    expr_substitute_param(e->right, name, value);
+}
+
+void stmt_substitute_param(struct stmt *s, const char *name, struct expr *value)
+{
+    if (!s)
+        return;
+    if (s->decl)
+        expr_substitute_param(s->decl->value, name, value);
+    expr_substitute_param(s->init_expr, name, value);
+    expr_substitute_param(s->expr, name, value);
+    expr_substitute_param(s->next_expr, name, value);
+    stmt_substitute_param(s->body, name, value);
+    stmt_substitute_param(s->else_body, name, value);
+    stmt_substitute_param(s->next, name, value);
+}
+
+int expr_reads_name(struct expr *e, const char *name)
+{ // true if e reads the parameter called name
+    if (!e)
+        return 0;
+    if (e->kind == EXPR_NAME && e->symbol && e->symbol->kind == SYMBOL_PARAM && !strcmp(e->name, name))
+        return 1;
+    return expr_reads_name(e->next, name) || expr_reads_name(e->left, name) || expr_reads_name(e->right, name);
+}
+
+int stmt_tests_name(struct stmt *s, const char *name)
+{ // true if a condition in s reads the parameter called name, so knowing its value removes branches
+    for (; s; s = s->next)
+    {
+        if ((s->kind == STMT_IF_ELSE || s->kind == STMT_FOR) && expr_reads_name(s->expr, name))
+            return 1;
+        if (stmt_tests_name(s->body, name) || stmt_tests_name(s->else_body, name))
+            return 1;
+    }
+    return 0;
+}
+
+int callgraph_clone_values(struct expr *call, struct decl *d, struct expr **values)
+{ // the literals call passes for parameters that d tests and never assigns, returns how many there are
+    struct expr *arg = call->right;
+    int found = 0;
+    int i = 0;
+    for (struct param_list *p = d->type->params; p; p = p->next, i++)
+    {
+        values[i] = 0;
+        if (arg && (arg->kind == EXPR_INT_LITERAL || arg->kind == EXPR_BOOL_LITERAL || arg->kind == EXPR_CHAR_LITERAL) && !stmt_assigns_name(d->code, p->name) && stmt_tests_name(d->code, p->name))
+        {
+            values[i] = arg;
+            found++;
+        }
+        if (arg)
+            arg = arg->next;
+    }
+    return found;
+}
+
+struct callgraph_clone *callgraph_clone_find(struct decl *d, struct expr **values)
+{
+    for (int c = 0; c < callgraph_clone_count; c++)
+    {
+        struct callgraph_clone *clone = &callgraph_clones[c];
+        if (clone->original != d)
+            continue;
+        int same = 1;
+        int i = 0;
+        for (struct param_list *p = d->type->params; p && same; p = p->next, i++)
+        {
+            if (!values[i] || !clone->values[i])
+                same = !values[i] && !clone->values[i];
+            else
+                same = values[i]->kind == clone->values[i]->kind && values[i]->literal_value == clone->values[i]->literal_value;
+        }
+        if (same)
+            return clone;
+    }
+    return 0;
+}
+
+void callgraph_clone_expr(struct expr *e, int redirect)
+{ // records the constant arguments of each call site, or with redirect points the site at the copy made for them
+    if (!e)
+        return;
+
+    struct callgraph_node *n = e->kind == EXPR_CALL && e->left ? callgraph_lookup(e->left->name) : 0;
+    if (n && n->decl->type->kind == TYPE_FUNCTION && n->decl->code && !strchr(n->decl->name, '.'))
+    {
+        int count = 0;
+        for (struct param_list *p = n->decl->type->params; p; p = p->next)
+            count++;
+        struct expr **values = calloc(count + 1, sizeof(*values));
+        int found = callgraph_clone_values(e, n->decl, values);
+        struct callgraph_clone *clone = found ? callgraph_clone_find(n->decl, values) : 0;
+        if (!redirect && found && !clone)
+        {
+            if (callgraph_clone_count == callgraph_clone_capacity)
+            {
+                callgraph_clone_capacity = callgraph_clone_capacity ? callgraph_clone_capacity * 2 : 16;
+                callgraph_clones = realloc(callgraph_clones, callgraph_clone_capacity * sizeof(*callgraph_clones));
+            }
+            clone = &callgraph_clones[callgraph_clone_count];
+            clone->original = n->decl;
+            clone->values = values;
+            clone->calls = 0;
+            callgraph_clone_count++;
+            clone->clone = 0;
+            values = 0;
+        }
+        if (!redirect && clone)
+            clone->calls++;
+        if (redirect && clone && clone->clone)
+        { // the arguments the copy has built in are dropped
+            struct expr **link = &e->right;
+            for (int i = 0; i < count && *link; i++)
+            {
+                if (clone->values[i])
+                    *link = (*link)->next;
+                else
+                    link = &(*link)->next;
+            }
+            e->left->name = clone->clone->name;
+            e->left->symbol = clone->clone->symbol;
+        }
+        free(values);
+    }
+
+    callgraph_clone_expr(e->next, redirect);
+    callgraph_clone_expr(e->left, redirect);
+    callgraph_clone_expr(e->right, redirect);
+}
+
+void callgraph_clone_stmt(struct stmt *s, int redirect)
+{
+    for (; s; s = s->next)
+    {
+        if (s->decl)
+            callgraph_clone_expr(s->decl->value, redirect);
+        callgraph_clone_expr(s->init_expr, redirect);
+        callgraph_clone_expr(s->expr, redirect);
+        callgraph_clone_expr(s->next_expr, redirect);
+        callgraph_clone_stmt(s->body, redirect);
+        callgraph_clone_stmt(s->else_body, redirect);
+    }
+}
+
+struct decl *callgraph_clone_create(struct callgraph_clone *c, int report)
+{ // copies the original with the literals built in and the parameters they replace removed, placed right after it
+    struct decl *d = c->original;
+    struct callgraph_node *n = callgraph_lookup(d->name);
+    char *name = malloc(strlen(d->name) + 24);
+    sprintf(name, "%s.spec.%d", d->name, ++n->clones);
+
+    struct stmt *code = stmt_copy(d->code);
+    struct param_list *params = 0;
+    struct param_list **tail = &params;
+    int i = 0;
+    for (struct param_list *p = d->type->params; p; p = p->next, i++)
+    {
+        if (c->values[i])
+        {
+            stmt_substitute_param(code, p->name, c->values[i]);
+            continue;
+        }
+        *tail = param_list_create(p->name, type_copy(p->type), 0);
+        tail = &(*tail)->next;
+    }
+    struct decl *clone = decl_create(name, type_create(TYPE_FUNCTION, type_copy(d->type->subtype), params, d->type->size), 0, code);
+
+    // the copy gets symbols of its own for its parameters and locals, resolved in the global scope that is still open
+    decl_resolve(clone, 0);
+    decl_typecheck(clone);
+    eval_fold_stmt(clone->code, report);
+
+    struct decl *after = d; // behind the copies made before it, so they come out in the order they were numbered
+    while (after->next && !strncmp(after->next->name, d->name, strlen(d->name)) && !strncmp(after->next->name + strlen(d->name), ".spec.", 6))
+        after = after->next;
+    clone->next = after->next;
+    after->next = clone;
+    struct callgraph_node *node = calloc(1, sizeof(*node));
+    node->decl = clone;
+    node->reachable = 1;
+    hash_table_insert(callgraph_nodes, name, node);
+    c->clone = clone;
+
+    if (report)
+        fprintf(stderr, "callgraph: %s specialized as %s for %d call site%s\n", d->name, name, c->calls, c->calls == 1 ? "" : "s");
+    return clone;
+}
+
+int callgraph_specialize(struct decl *program, int report)
+{ // copies functions for the constant arguments passed most often, within a budget, and calls the copies instead
+    struct decl *d;
+    callgraph_clone_count = 0;
+    for (d = program; d; d = d->next)
+    {
+        if (d->type->kind == TYPE_FUNCTION)
+            callgraph_clone_stmt(d->code, 0);
+    }
+
+    // the combinations seen at the most call sites get copied first, ties going to the one seen first
+    int made;
+    for (made = 0; made < CALLGRAPH_MAX_CLONES; made++)
+    {
+        struct callgraph_clone *best = 0;
+        for (int c = 0; c < callgraph_clone_count; c++)
+        {
+            struct callgraph_clone *clone = &callgraph_clones[c];
+            if (clone->clone || clone->calls <= 0 || stmt_size(clone->original->code) > CALLGRAPH_CLONE_SIZE)
+                continue;
+            if (!best || clone->calls > best->calls)
+                best = clone;
+        }
+        if (!best)
+            break;
+        callgraph_clone_create(best, report);
+    }
+
+    for (d = program; d; d = d->next)
+    {
+        if (d->type->kind == TYPE_FUNCTION)
+            callgraph_clone_stmt(d->code, 1);
+    }
+    return made;
+}
+
+struct decl *callgraph_prune(struct decl *program, int report)
+{ // unlinks the functions and globals that nothing C may use can reach
+    struct decl *d;
+    for (d = program; d; d = d->next)
+    {
+        struct callgraph_node *n = callgraph_lookup(d->name);
+        if (n && n->decl == d)
+            n->reachable = 0;
+    }
+
+    // everything C may use is a root
+    for (d = program; d; d = d->next)
+    {
+        struct callgraph_node *n = callgraph_lookup(d->name);
+        if (n && n->decl == d && callgraph_is_exported(d->name))
+        {
+            n->exported = 1;
+            if (!n->reachable)
+            {
+                n->reachable = 1;
+                callgraph_visit_expr(d->value);
+                callgraph_visit_stmt(d->code);
+            }
+        }
+    }
+
+    // unlink whatever was not reached
+    struct decl **link = &program;
+    while (*link)
+    {
+        d = *link;
+        struct callgraph_node *n = callgraph_lookup(d->name);
+        if (n && n->decl == d && !n->reachable)
+        {
+            if (report)
+                fprintf(stderr, "callgraph: removed unused %s %s\n", d->type->kind == TYPE_FUNCTION ? "function" : "global", d->name);
+            *link = d->next;
+            continue;
+        }
+        link = &d->next;
+    }
+    return program;
+}
+
+struct decl *callgraph_optimize(struct decl *program, int report)
+{ // removes functions and globals that main cannot reach and propagates constant arguments
+    struct decl *d;
+
+    callgraph_nodes = hash_table_create(0, 0);
+    callgraph_has_main = 0;
+    for (d = program; d; d = d->next)
+    {
+        if (d->type->kind == TYPE_FUNCTION && !d->code)
+            continue; // prototypes generate no code
+        if (!strcmp(d->name, "main"))
+            callgraph_has_main = 1;
+        struct callgraph_node *n = calloc(1, sizeof(*n));
+        n->decl = d;
+        if (!hash_table_insert(callgraph_nodes, d->name, n))
+            free(n);
+    }
+
+    program = callgraph_prune(program, report);
+
+    // interprocedural constant propagation into parameters of internal functions
+    for (d = program; d; d = d->next)
+    {
+        struct callgraph_node *n = callgraph_lookup(d->name);
+        if (!n || n->decl != d || n->exported || d->type->kind != TYPE_FUNCTION)
+            continue;
+        int count = 0;
+        for (struct param_list *p = d->type->params; p; p = p->next)
+            count++;
+        n->const_args = calloc(count + 1, sizeof(*n->const_args));
+        n->varying = calloc(count + 1, sizeof(*n->varying));
+    }
+    for (d = program; d; d = d->next)
+    {
+        if (d->type->kind == TYPE_FUNCTION)
+            callgraph_collect_stmt(d->code);
+        else
+            callgraph_collect_expr(d->value);
+    }
+    for (d = program; d; d = d->next)
+    {
+        struct callgraph_node *n = callgraph_lookup(d->name);
+        if (!n || n->decl != d || !n->const_args || !n->calls)
+            continue;
+        int i = 0;
+        for (struct param_list *p = d->type->params; p; p = p->next, i++)
+        {
+            if (n->varying[i] || !n->const_args[i] || stmt_assigns_name(d->code, p->name))
+                continue;
+            stmt_substitute_param(d->code, p->name, n->const_args[i]);
+            if (report)
+            {
+                fprintf(stderr, "callgraph: %s always receives %s = ", d->name, p->name);
+                switch (n->const_args[i]->kind)
+                {
+                case EXPR_BOOL_LITERAL:
+                    fprintf(stderr, "%s\n", n->const_args[i]->literal_value ? "true" : "false");
+                    break;
+                case EXPR_CHAR_LITERAL:
+                    fprintf(stderr, "'%c'\n", n->const_args[i]->literal_value);
+                    break;
+                default:
+                    fprintf(stderr, "%d\n", n->const_args[i]->literal_value);
+                }
+            }
+        }
+    }
+
+    if (callgraph_specialize(program, report))
+        program = callgraph_prune(program, report); // originals every call now skips
+    return program;
+}
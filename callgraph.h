@@ -0,0 +1,55 @@
+#ifndef CALLGRAPH_H
+#define CALLGRAPH_H
+
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+#include "hash_table.h"
+
+/* most copies of functions specialized for constant arguments, and the largest body, in nodes, worth copying */
+#define CALLGRAPH_MAX_CLONES 8
+#define CALLGRAPH_CLONE_SIZE 256
+
+struct callgraph_node {
+	struct decl *decl;         // function definition or global variable
+	int reachable;
+	int exported;              // may be used from C, so it is a root and its signature is fixed
+	int calls;                 // number of call sites seen in reachable code
+	struct expr **const_args;  // literal passed for each parameter at every call so far
+	int *varying;              // parameter received different or non-literal values
+	int clobbers;              // scratch registers the body or its callees may overwrite, as a bit mask
+	int clones;                // specialized copies made of it, which number the next one
+};
+
+struct callgraph_clone {
+	struct decl *original;
+	struct expr **values;      // literal each parameter is specialized for, 0 where it stays a parameter
+	int calls;                 // call sites passing exactly these literals
+	struct decl *clone;        // the copy, once the budget allowed it
+};
+
+extern struct hash_table *callgraph_nodes;
+
+void callgraph_export(const char *name);
+int callgraph_is_exported(const char *name);
+struct decl* callgraph_optimize(struct decl *program, int report);
+
+struct callgraph_node* callgraph_lookup(const char *name);
+void callgraph_visit_expr(struct expr *e);
+void callgraph_visit_stmt(struct stmt *s);
+void callgraph_collect_expr(struct expr *e);
+void callgraph_collect_stmt(struct stmt *s);
+int callgraph_expr_clobbers(struct expr *e);
+int callgraph_stmt_clobbers(struct stmt *s);
+void callgraph_close_clobbers(struct decl *program);
+
+int stmt_assigns_name(struct stmt *s, const char *name);
+int expr_assigns_name(struct expr *e, const char *name);
+void stmt_substitute_param(struct stmt *s, const char *name, struct expr *value);
+void expr_substitute_param(struct expr *e, const char *name, struct expr *value);
+int expr_reads_name(struct expr *e, const char *name);
+int stmt_tests_name(struct stmt *s, const char *name);
+int callgraph_specialize(struct decl *program, int report);
+struct decl* callgraph_prune(struct decl *program, int report);
+
+#endif
@@ -2,7 +2,15 @@
 #include "scope.h"
 #include "label.c"
 #include "scratch.h"
+#include "eval.h"
+#include "layout.h"
+#include "frame.h"
+#include "callgraph.h"
+#include "induct.h"
+#include "memo.h"
+#include "icf.h"
 #include <string.h>
+#include <stdint.h>
 #include <stdio.h>
 
 extern int typerr;
@@ -38,6 +46,17 @@ void decl_delete(struct decl *d)
         free(d);
 }
 
+struct decl *decl_copy(struct decl *d)
+{ // copy of a list of local declarations, which keep their symbols
+    if (!d)
+        return 0;
+    struct decl *c = decl_create(d->name, type_copy(d->type), expr_copy(d->value), stmt_copy(d->code));
+    c->symbol = d->symbol;
+    c->param_number = d->param_number;
+    c->next = decl_copy(d->next);
+    return c;
+}
+
 void decl_print(struct decl *d, int indent)
 {
     if (!d)
@@ -45,16 +64,10 @@ void decl_print(struct decl *d, int indent)
     //print_tabs(indent);
     printf("%s:", d->name);
     type_print(d->type);
-    if (d->type->kind == TYPE_ARRAY)
+    if (d->type->kind == TYPE_ARRAY && d->value)
     {
-        struct expr* ptr = d->value;
-        printf(" = {");
-        while (ptr) {
-            exprs_print(ptr, 0);
-            printf(", ");
-            ptr = ptr->right;
-        }
-        printf("}");
+        printf(" = ");
+        expr_print(d->value);
     }
     else if (d->value)
     {
@@ -176,28 +189,12 @@ void decl_typecheck(struct decl *d)
         }
         else if (d->type->kind == TYPE_ARRAY)
         {                 // array typechecking
-            int iter = 0; // to count the numbers and check for size
-
-            struct expr *eptr = d->value;
-
-            while (eptr)
-            {
-                // compare each type to the individual expression
-                iter++;
-                if (!type_compare(expr_typecheck(eptr), d->type->subtype))
-                { // type_compare(element, array)
-                    fprintf(stderr, "type error: array type and item declaration do not match");
-                    typerr++;
-                }
+            int iter = t->size; // to count the numbers and check for size
 
-                if (eptr->right)
-                {
-                    eptr = eptr->right;
-                }
-                else
-                {
-                    eptr = 0;
-                }
+            if (d->value->kind != EXPR_ARRAY_LITERAL || d->value->elements->mismatched || (iter && !type_compare(t->subtype, d->type->subtype)))
+            { // every element is a literal of the array's type
+                fprintf(stderr, "type error: array type and item declaration do not match\n");
+                typerr++;
             }
             if (d->type->size)
             {
@@ -233,6 +230,9 @@ void decl_typecheck(struct decl *d)
     decl_typecheck(d->next);
 }
 
+int decl_function_sections = 0; // set by -ffunction-sections
+int decl_data_sections = 0;     // set by -fdata-sections
+
 void decl_codegen(struct decl *d, FILE *outfile)
 {
     if (!d)
@@ -247,46 +247,56 @@ void decl_codegen(struct decl *d, FILE *outfile)
         case TYPE_INTEGER:
         case TYPE_CHARACTER:
         case TYPE_BOOLEAN:
-            fprintf(outfile, ".data\n");
-            fprintf(outfile, ".global %s\n", d->name);
-            if (d->value->literal_value) {
-                fprintf(outfile, "%s: .quad %li\n", d->name, (long int)(d->value->literal_value));
-            } else {
-                fprintf(outfile, "%s: .quad 0\n", d->name);
+            ;;
+            long initial = 0;
+            if (d->value && !eval_constant(d->value, &initial)) {
+                fprintf(stderr, "code generation error: initializer of global %s is not a constant\n", d->name);
             }
+            decl_section_data(d->name, !initial, outfile);
+            decl_linkage(d->name, outfile);
+            if (initial)
+                fprintf(outfile, "%s: .quad %li\n", d->name, initial);
+            else
+                fprintf(outfile, "%s: .zero 8\n", d->name);
             break;
         case TYPE_STRING:
-            fprintf(outfile, ".data\n");
-            fprintf(outfile, ".global %s\n", d->name);
+            decl_section_data(d->name, 0, outfile);
+            decl_linkage(d->name, outfile);
             fprintf(outfile, "%s: .string %s\n", d->name, d->value->string_literal);
             break;
         case TYPE_ARRAY:
-            fprintf(outfile, ".data\n");
-            struct expr *arrptr = d->value;
             if (d->type->subtype->kind == TYPE_STRING) {
                 fprintf(stderr, "code generation error: arrays of strings not supported\n");
-            } else if (d->type->subtype->kind == TYPE_STRING) {
+            } else if (d->type->subtype->kind == TYPE_ARRAY) {
                 fprintf(stderr, "code generation error: multi-dimensional arrays not supported\n");
-            } else  {
-                struct expr* arrptr = d->value->right;
-                char BUFFER[BUFSIZ];
-                char name[BUFSIZ];
-                sprintf(name, "%s: .quad %li", d->name, (long int)d->value->literal_value);
-                while (arrptr)  {
-                    sprintf(BUFFER, ", %li", (long int)arrptr->literal_value);
-                    strcat(name, BUFFER);
-                    arrptr = arrptr->right;
-                }
-                strcat(name, "\n");
-                fputs(name, outfile);
+            } else {
+                decl_array_codegen(d, outfile);
             }
             break;
         case TYPE_FUNCTION:
             if (d->code)
             { // if no code, it's a preamble, which makes it useless for codegen, only used in type checking
-                fprintf(outfile, ".text\n");
-                fprintf(outfile, ".global %s\n", d->name);
-                fprintf(outfile, "%s:\n", d->name); // emit label with function's name
+                // the body takes the internal convention, C reaches exported functions through decl_codegen_entries
+                const char *body = decl_body_name(d);
+                FILE *function = outfile;
+                char *compute = 0;
+                if (memo_function(d)) { // callers reach the cache first, the body runs only on a miss
+                    compute = memo_codegen(d, outfile);
+                    body = compute;
+                } else {
+                    outfile = icf_begin(); // held back until it is known not to repeat an earlier function
+                }
+                if (outfile != function && icf_thunk(d, body, outfile)) {
+                    struct callgraph_node *n = callgraph_lookup(d->name);
+                    if (n) n->clobbers = 0; // whatever the body it jumps to clobbers, closed over later
+                    icf_end(d, body, outfile, function);
+                    outfile = function;
+                    break;
+                }
+                decl_section_text(body, outfile);
+                decl_linkage(body, outfile);
+                fprintf(outfile, ".p2align 4\n");
+                fprintf(outfile, "%s:\n", body); // emit label with function's name
 
                 // preamble of function
                 fprintf(outfile, "\tPUSHQ %%rbp\n");       // pushing base pointer
@@ -295,59 +305,48 @@ void decl_codegen(struct decl *d, FILE *outfile)
                 struct param_list *ptr = d->type->params;
                 
                 int argctr = 0;
-                int varctr = 0;
+                int homed = 0;
+                int framesize = frame_layout(d);
                 while (ptr)
-                { // pushing old values of argument regs into stack
-                    fprintf(outfile, "\tPUSHQ %s\n", arg_name(argctr));
-                    if (ptr->next) {
-                        ptr = ptr->next;
-                        argctr++;} else {
-                        break;
+                { // parameters that do not stay in their register live in the stack frame
+                    if (argctr < ARGS_INTERNAL && !ptr->symbol->reg) {
+                        fprintf(outfile, "\tPUSHQ %s\n", arg_name(argctr));
+                        homed++;
                     }
+                    argctr++;
+                    ptr = ptr->next;
                 }
 
                 d->param_number = argctr;
 
-                // count number of local variables needed to allocate them - NOTE: make recursive for logic stuff
-                struct stmt *stptr = d->code;
-                
-                while (stptr) {
-                    if (stptr->kind == STMT_DECL) {
-                        varctr++;
-                    }
-                    stptr = stptr->next;
+                if (framesize > homed * 8) {
+                    fprintf(outfile, "\tSUBQ $%i, %%rsp\n", framesize - homed * 8); // locals of every nested scope
                 }
-                fprintf(outfile, "\tSUBQ $%i, %%rsp\n", varctr * 8); // allocate additional local variables
+                stack_depth = framesize; // calls pad the stack from here to keep it 16 byte aligned
 
-                // indiscriminately save callee-saved registers
-                fprintf(outfile, "\tPUSHQ %%rbx\n");
-                fprintf(outfile, "\tPUSHQ %%r12\n");
-                fprintf(outfile, "\tPUSHQ %%r13\n");
-                fprintf(outfile, "\tPUSHQ %%r14\n");
-                fprintf(outfile, "\tPUSHQ %%r15\n");
-
-                // generating actual content of function
+                // no callee-saved registers: callers keep what they need across calls to our functions
+                scratch_used = 0;
+                layout_begin_function();
+                induct_begin_function(d);
                 stmt_codegen(d->code, outfile);
+                struct callgraph_node *n = callgraph_lookup(d->name);
+                if (n) {
+                    n->clobbers = scratch_used;
+                    if (memo_function(d)) n->clobbers |= 1 << 1 | 1 << 2; // the cache is reached with System V calls
+                }
 
                 // postamble of function
                 fprintf(outfile, "\n.%s_epilogue:\n", d->name);
-
-                // restore argument registers that were thrown in
-                for (int j = argctr; j > 0; j--)
-                {
-                    fprintf(outfile, "\tPOPQ %s\n", arg_name(j));
-                }
-                // restore callee-saved registers
-                fprintf(outfile, "\tPOPQ %%r15\n");
-                fprintf(outfile, "\tPOPQ %%r14\n");
-                fprintf(outfile, "\tPOPQ %%r13\n");
-                fprintf(outfile, "\tPOPQ %%r12\n");
-                fprintf(outfile, "\tPOPQ %%rbx\n");
-
                 fprintf(outfile, "\tMOVQ %%rbp, %%rsp\n"); // reset stack to base pointer
                 fprintf(outfile, "\tPOPQ %%rbp\n");        // restore old base pointer
 
                 fprintf(outfile, "\tRET\n"); // return to caller - stuff to do return statemnts as well
+                layout_end_function(body, outfile);
+                if (outfile != function) {
+                    icf_end(d, body, outfile, function);
+                    outfile = function;
+                }
+                free(compute);
             }
             break;
         }
@@ -359,14 +358,16 @@ void decl_codegen(struct decl *d, FILE *outfile)
         case TYPE_INTEGER:
         case TYPE_CHARACTER:
         case TYPE_BOOLEAN:
-            expr_codegen(d->value, outfile); // generating code for expression, reg value will be placed in d->value->reg
-            if (d->value)
+            ;;
+            int byte = symbol_size(d->symbol) == 1; // chars and booleans take a single byte in the frame
+            if (!d->value || expr_literal(d->value, 0))
             {
-                fprintf(outfile, "\tMOVQ %s, %s\n", scratch_name(d->value->reg), symbol_codegen(d->symbol));
-                scratch_free(d->value->reg); // d->value->reg is saved
-            } else {
-                fprintf(outfile, "\tMOVQ $0, %s\n", symbol_codegen(d->symbol)); // moving empty value into saved register
+                fprintf(outfile, "\t%s %s, %s\n", byte ? "MOVB" : "MOVQ", d->value ? expr_operand(d->value) : "$0", symbol_codegen(d->symbol));
+                break;
             }
+            expr_codegen(d->value, outfile); // generating code for expression, reg value will be placed in d->value->reg
+            fprintf(outfile, "\t%s %s, %s\n", byte ? "MOVB" : "MOVQ", byte ? scratch_byte_name(d->value->reg) : scratch_name(d->value->reg), symbol_codegen(d->symbol));
+            scratch_free(d->value->reg); // d->value->reg is saved
 
             break;
         case TYPE_STRING:
@@ -387,3 +388,136 @@ void decl_codegen(struct decl *d, FILE *outfile)
     decl_codegen(d->next, outfile);
     return;
 }
+
+const char *decl_body_name(struct decl *d)
+{ // label of the internal convention body of function d, exported functions keep their own name for the System V entry
+    if (!callgraph_is_exported(d->name))
+        return d->name;
+    char *name = malloc(strlen(d->name) + 10);
+    sprintf(name, "%s.internal", d->name);
+    return name;
+}
+
+void decl_codegen_entries(struct decl *d, FILE *outfile)
+{ // System V entry stubs of exported functions: they save the callee-saved registers the body may clobber and pass the arguments on
+    const int callee_saved[] = {0, 3, 4, 5, 6}; // rbx and r12 to r15
+    callgraph_close_clobbers(d);
+
+    for (; d; d = d->next)
+    {
+        if (d->type->kind != TYPE_FUNCTION || !d->code || !callgraph_is_exported(d->name))
+            continue;
+        struct callgraph_node *n = callgraph_lookup(d->name);
+        int count = 0;
+        int saves = 0;
+        for (struct param_list *p = d->type->params; p; p = p->next)
+            count++;
+        int stacked = count > ARGS_INTERNAL ? count - ARGS_INTERNAL : 0;
+        for (int i = 0; i < 5; i++)
+            saves += (n->clobbers >> callee_saved[i]) & 1;
+        int pad = (saves + stacked) % 2 ? 0 : 8; // the return address leaves the stack 8 bytes off alignment
+
+        decl_section_text(d->name, outfile);
+        decl_linkage(d->name, outfile);
+        fprintf(outfile, ".p2align 4\n");
+        fprintf(outfile, "%s:\n", d->name);
+        if (!saves && count <= ARGS_SYSTEM_V)
+        { // nothing to convert, the body can return to the caller itself
+            fprintf(outfile, "\tJMP %s\n\n", decl_body_name(d));
+            continue;
+        }
+        for (int i = 0; i < 5; i++)
+        {
+            if (n->clobbers & (1 << callee_saved[i]))
+                fprintf(outfile, "\tPUSHQ %s\n", scratch_name(callee_saved[i]));
+        }
+        if (pad)
+            fprintf(outfile, "\tSUBQ $%i, %%rsp\n", pad);
+
+        // System V passes the seventh argument and up above the return address, the body takes the seventh in rax and the rest pushed
+        int incoming = saves * 8 + pad + 8;
+        for (int i = count - 1, pushed = 0; i >= ARGS_INTERNAL; i--, pushed++)
+            fprintf(outfile, "\tPUSHQ %i(%%rsp)\n", incoming + (i - ARGS_SYSTEM_V) * 8 + pushed * 8);
+        if (count > ARGS_SYSTEM_V)
+            fprintf(outfile, "\tMOVQ %i(%%rsp), %%rax\n", incoming + stacked * 8);
+
+        fprintf(outfile, "\tCALL %s\n", decl_body_name(d));
+        if (pad + stacked * 8)
+            fprintf(outfile, "\tADDQ $%i, %%rsp\n", pad + stacked * 8);
+        for (int i = 4; i >= 0; i--)
+        {
+            if (n->clobbers & (1 << callee_saved[i]))
+                fprintf(outfile, "\tPOPQ %s\n", scratch_name(callee_saved[i]));
+        }
+        fprintf(outfile, "\tRET\n\n");
+    }
+}
+
+void decl_section_text(const char *name, FILE *outfile)
+{ // with -ffunction-sections every function gets a section the linker can drop when nothing calls it
+    if (decl_function_sections)
+        fprintf(outfile, ".section .text.%s,\"ax\",@progbits\n", name);
+    else
+        fprintf(outfile, ".text\n");
+}
+
+void decl_section_data(const char *name, int zero, FILE *outfile)
+{ // data starting out as zero takes no room in the file, -fdata-sections gives each global its own section
+    if (decl_data_sections)
+        fprintf(outfile, zero ? ".section .bss.%s,\"aw\",@nobits\n" : ".section .data.%s,\"aw\",@progbits\n", name);
+    else
+        fprintf(outfile, zero ? ".bss\n" : ".data\n");
+}
+
+void decl_linkage(const char *name, FILE *outfile)
+{ // labels stay local to the unit unless C code may use them
+    if (callgraph_is_exported(name))
+        fprintf(outfile, ".global %s\n", name);
+}
+
+void decl_array_codegen(struct decl *d, FILE *outfile)
+{ // written out a line at a time: runs of one value become .fill, the zeros at the end .zero, and an array of zeros goes to .bss
+    struct expr_elements *elements = d->value && d->value->kind == EXPR_ARRAY_LITERAL ? d->value->elements : 0;
+    int count = elements ? elements->count : 0;
+    int size = d->type->size > count ? d->type->size : count;
+    int width = symbol_element_size(d->symbol); // chars and booleans take a byte each
+    const char *directive = width == 1 ? ".byte" : ".quad";
+    while (count && !elements->values[count - 1])
+        count--;
+
+    decl_section_data(d->name, !count, outfile);
+    decl_linkage(d->name, outfile);
+    fprintf(outfile, "%s:\n", d->name);
+    int i = 0;
+    while (i < count)
+    {
+        int run = 1;
+        while (i + run < count && elements->values[i + run] == elements->values[i])
+            run++;
+        if (run >= DECL_ARRAY_FILL && width == 8 && (elements->values[i] < 0 || elements->values[i] > UINT32_MAX))
+        { // .fill only takes a four byte value and zero extends it
+            fprintf(outfile, "\t.rept %i\n\t.quad %li\n\t.endr\n", run, elements->values[i]);
+            i += run;
+            continue;
+        }
+        if (run >= DECL_ARRAY_FILL)
+        {
+            fprintf(outfile, "\t.fill %i, %i, %li\n", run, width, elements->values[i]);
+            i += run;
+            continue;
+        }
+        fprintf(outfile, "\t%s %li", directive, elements->values[i++]);
+        for (int n = 1; n < DECL_ARRAY_LINE && i < count; n++, i++)
+        {
+            for (run = 1; i + run < count && elements->values[i + run] == elements->values[i]; run++)
+                ;
+            if (run >= DECL_ARRAY_FILL)
+                break; // the run gets a .fill of its own
+            fprintf(outfile, ", %li", elements->values[i]);
+        }
+        fprintf(outfile, "\n");
+    }
+    long bytes = ((long)size * width + 7) / 8 * 8; // byte arrays are padded so the globals after them stay 8 byte aligned
+    if (bytes > (long)count * width)
+        fprintf(outfile, "\t.zero %li\n", bytes - (long)count * width);
+}
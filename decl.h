@@ -20,10 +20,24 @@ struct decl {
 	int param_number;
 };
 
+/* values written on one line of an array initializer, and the shortest run of one value written as .fill */
+#define DECL_ARRAY_LINE 16
+#define DECL_ARRAY_FILL 4
+
+extern int decl_function_sections;
+extern int decl_data_sections;
+
 struct decl * decl_create( char *name, struct type *type, struct expr *value, struct stmt *code);
 void decl_print( struct decl* d, int indent );
 void decl_delete(struct decl* d);
+struct decl* decl_copy(struct decl* d);
 void decl_resolve(struct decl* d, int print);
 void decl_typecheck(struct decl* d);
 void decl_codegen(struct decl* d, FILE* outfile);
+const char* decl_body_name(struct decl* d);
+void decl_codegen_entries(struct decl* d, FILE* outfile);
+void decl_section_text(const char* name, FILE* outfile);
+void decl_section_data(const char* name, int zero, FILE* outfile);
+void decl_linkage(const char* name, FILE* outfile);
+void decl_array_codegen(struct decl* d, FILE* outfile);
 #endif
\ No newline at end of file
@@ -0,0 +1,456 @@
+#include "eval.h"
+#include "symbol.h"
+#include "hash_table.h"
+#include <string.h>
+#include <limits.h>
+
+struct eval_function {
+	struct decl *decl;
+	int pure;
+};
+
+struct eval_binding {
+	const char *name;
+	long value;
+};
+
+struct hash_table *eval_functions = 0;
+
+struct eval_binding *eval_env = 0; // bindings of the functions being evaluated, innermost last
+int eval_env_top = 0;
+int eval_env_capacity = 0;
+int eval_frame = 0; // first binding visible to the current function
+
+long eval_steps = 0;
+int eval_depth = 0;
+
+int eval_value_type(struct type *t)
+{ // only scalar values can be computed at compile time
+    return t && (t->kind == TYPE_INTEGER || t->kind == TYPE_BOOLEAN || t->kind == TYPE_CHARACTER);
+}
+
+int eval_expr_pure(struct expr *e)
+{ // no global state is read or written and every callee is pure
+    if (!e)
+        return 1;
+    switch (e->kind)
+    {
+    case EXPR_NAME:
+        if (!e->symbol || e->symbol->kind == SYMBOL_GLOBAL || !eval_value_type(e->symbol->type))
+            return 0;
+        break;
+    case EXPR_STRING_LITERAL:
+    case EXPR_ARRACC:
+        return 0;
+    case EXPR_ASSGN:
+    case EXPR_INCR:
+    case EXPR_DECR:
+        if (e->left->kind != EXPR_NAME)
+            return 0;
+        break;
+    case EXPR_CALL:
+        if (!eval_is_pure(e->left->name))
+            return 0;
+        return eval_expr_pure(e->right) && eval_expr_pure(e->next);
+    }
+    return eval_expr_pure(e->left) && eval_expr_pure(e->right) && eval_expr_pure(e->next);
+}
+
+int eval_stmt_pure(struct stmt *s)
+{
+    if (!s)
+        return 1;
+    switch (s->kind)
+    {
+    case STMT_PRINT:
+        return 0;
+    case STMT_DECL:
+        if (!eval_value_type(s->decl->type) || !eval_expr_pure(s->decl->value))
+            return 0;
+        break;
+    case STMT_RETURN:
+        if (s->expr && s->expr->kind != TYPE_VOID && !eval_expr_pure(s->expr))
+            return 0;
+        return eval_stmt_pure(s->next);
+    }
+    return eval_expr_pure(s->init_expr) && eval_expr_pure(s->expr) && eval_expr_pure(s->next_expr) && eval_stmt_pure(s->body) && eval_stmt_pure(s->else_body) && eval_stmt_pure(s->next);
+}
+
+void eval_analyze(struct decl *program)
+{ // finds the pure functions, optimistically assuming recursive calls are pure until shown otherwise
+    struct decl *d;
+
+    eval_functions = hash_table_create(0, 0);
+    for (d = program; d; d = d->next)
+    {
+        if (d->type->kind != TYPE_FUNCTION || !d->code)
+            continue;
+        struct eval_function *f = calloc(1, sizeof(*f));
+        f->decl = d;
+        f->pure = eval_value_type(d->type->subtype);
+        for (struct param_list *p = d->type->params; p; p = p->next)
+        {
+            if (!eval_value_type(p->type))
+                f->pure = 0;
+        }
+        if (!hash_table_insert(eval_functions, d->name, f))
+            free(f);
+    }
+
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        char *key;
+        void *value;
+        hash_table_firstkey(eval_functions);
+        while (hash_table_nextkey(eval_functions, &key, &value))
+        {
+            struct eval_function *f = value;
+            if (f->pure && !eval_stmt_pure(f->decl->code))
+            {
+                f->pure = 0;
+                changed = 1;
+            }
+        }
+    }
+}
+
+int eval_is_pure(const char *name)
+{
+    struct eval_function *f = eval_functions ? hash_table_lookup(eval_functions, name) : 0;
+    return f && f->pure;
+}
+
+int eval_is_constant(struct expr *e)
+{ // made only of literals, operators and calls of pure functions on such expressions
+    if (!e)
+        return 1;
+    switch (e->kind)
+    {
+    case EXPR_INT_LITERAL:
+    case EXPR_BOOL_LITERAL:
+    case EXPR_CHAR_LITERAL:
+        return 1;
+    case EXPR_NAME:
+    case EXPR_STRING_LITERAL:
+    case EXPR_ARRACC:
+    case EXPR_ASSGN:
+    case EXPR_INCR:
+    case EXPR_DECR:
+        return 0;
+    case EXPR_CALL:
+        if (!eval_is_pure(e->left->name))
+            return 0;
+        for (struct expr *arg = e->right; arg; arg = arg->next)
+        {
+            if (!eval_is_constant(arg))
+                return 0;
+        }
+        return 1;
+    }
+    return eval_is_constant(e->left) && eval_is_constant(e->right);
+}
+
+int eval_constant(struct expr *e, long *result)
+{ // computes a constant expression, failing if it is not one or runs over budget
+    if (!eval_is_constant(e))
+        return 0;
+    eval_steps = 0;
+    eval_depth = 0;
+    eval_env_top = 0;
+    eval_frame = 0;
+    return eval_expr(e, result) == EVAL_OK;
+}
+
+long *eval_lookup(const char *name)
+{
+    for (int i = eval_env_top - 1; i >= eval_frame; i--)
+    {
+        if (!strcmp(eval_env[i].name, name))
+            return &eval_env[i].value;
+    }
+    return 0;
+}
+
+void eval_bind(const char *name, long value)
+{
+    if (eval_env_top == eval_env_capacity)
+    {
+        eval_env_capacity = eval_env_capacity ? eval_env_capacity * 2 : 64;
+        eval_env = realloc(eval_env, eval_env_capacity * sizeof(*eval_env));
+    }
+    eval_env[eval_env_top].name = name;
+    eval_env[eval_env_top].value = value;
+    eval_env_top++;
+}
+
+eval_t eval_expr(struct expr *e, long *result)
+{
+    long l = 0, r = 0;
+    long *var;
+
+    if (++eval_steps > EVAL_STEP_BUDGET)
+        return EVAL_FAIL;
+
+    switch (e->kind)
+    {
+    case EXPR_INT_LITERAL:
+    case EXPR_BOOL_LITERAL:
+    case EXPR_CHAR_LITERAL:
+        *result = e->literal_value;
+        return EVAL_OK;
+
+    case EXPR_NAME:
+        if (!(var = eval_lookup(e->name)))
+            return EVAL_FAIL;
+        *result = *var;
+        return EVAL_OK;
+
+    case EXPR_GROUP:
+        return eval_expr(e->right, result);
+
+    case EXPR_ASSGN:
+        if (e->left->kind != EXPR_NAME || !(var = eval_lookup(e->left->name)) || eval_expr(e->right, &r) != EVAL_OK)
+            return EVAL_FAIL;
+        *var = r;
+        *result = r;
+        return EVAL_OK;
+
+    case EXPR_INCR:
+    case EXPR_DECR:
+        if (e->left->kind != EXPR_NAME || !(var = eval_lookup(e->left->name)))
+            return EVAL_FAIL;
+        *result = *var;
+        *var += e->kind == EXPR_INCR ? 1 : -1;
+        return EVAL_OK;
+
+    case EXPR_NOT:
+        if (eval_expr(e->right, &r) != EVAL_OK)
+            return EVAL_FAIL;
+        *result = !r;
+        return EVAL_OK;
+
+    case EXPR_NEG:
+        if (eval_expr(e->right, &r) != EVAL_OK)
+            return EVAL_FAIL;
+        *result = (long)(0UL - (unsigned long)r);
+        return EVAL_OK;
+
+    case EXPR_CALL:
+        ;;
+        struct eval_function *f = hash_table_lookup(eval_functions, e->left->name);
+        long args[64];
+        int count = 0;
+        if (!f || !f->pure)
+            return EVAL_FAIL;
+        for (struct expr *arg = e->right; arg; arg = arg->next)
+        {
+            if (count == 64 || eval_expr(arg, &args[count++]) != EVAL_OK)
+                return EVAL_FAIL;
+        }
+        return eval_call(f->decl, args, count, result);
+    }
+
+    // binary operators evaluate both sides, just like the generated code
+    if (!e->left || !e->right || eval_expr(e->left, &l) != EVAL_OK || eval_expr(e->right, &r) != EVAL_OK)
+        return EVAL_FAIL;
+
+    switch (e->kind)
+    {
+    case EXPR_OR:  *result = l || r; break;
+    case EXPR_AND: *result = l && r; break;
+    case EXPR_GT:  *result = l > r; break;
+    case EXPR_GE:  *result = l >= r; break;
+    case EXPR_LT:  *result = l < r; break;
+    case EXPR_LE:  *result = l <= r; break;
+    case EXPR_EQ:  *result = l == r; break;
+    case EXPR_NEQ: *result = l != r; break;
+    case EXPR_ADD: *result = (long)((unsigned long)l + (unsigned long)r); break;
+    case EXPR_SUB: *result = (long)((unsigned long)l - (unsigned long)r); break;
+    case EXPR_MUL: *result = (long)((unsigned long)l * (unsigned long)r); break;
+    case EXPR_DIV:
+    case EXPR_MOD:
+        if (r == 0 || (l == LONG_MIN && r == -1))
+            return EVAL_FAIL; // would trap at runtime, so leave it to runtime
+        *result = e->kind == EXPR_DIV ? l / r : l % r;
+        break;
+    case EXPR_EXPO: // same loop as integer_power in library.c
+        *result = 1;
+        for (; r > 0; r--)
+        {
+            *result = (long)((unsigned long)*result * (unsigned long)l);
+            if (++eval_steps > EVAL_STEP_BUDGET)
+                return EVAL_FAIL;
+        }
+        break;
+    default:
+        return EVAL_FAIL;
+    }
+    return EVAL_OK;
+}
+
+eval_t eval_stmt(struct stmt *s, long *result)
+{
+    long v = 0;
+    int scope;
+    eval_t status;
+
+    for (; s; s = s->next)
+    {
+        if (++eval_steps > EVAL_STEP_BUDGET)
+            return EVAL_FAIL;
+
+        switch (s->kind)
+        {
+        case STMT_DECL:
+            v = 0;
+            if (s->decl->value && eval_expr(s->decl->value, &v) != EVAL_OK)
+                return EVAL_FAIL;
+            eval_bind(s->decl->name, v);
+            break;
+        case STMT_EXPR:
+            if (eval_expr(s->expr, &v) != EVAL_OK)
+                return EVAL_FAIL;
+            break;
+        case STMT_RETURN:
+            if (s->expr && s->expr->kind != TYPE_VOID && eval_expr(s->expr, result) != EVAL_OK)
+                return EVAL_FAIL;
+            return EVAL_RETURN;
+        case STMT_BLOCK:
+            scope = eval_env_top;
+            status = eval_stmt(s->body, result);
+            eval_env_top = scope;
+            if (status != EVAL_OK)
+                return status;
+            break;
+        case STMT_IF_ELSE:
+            if (eval_expr(s->expr, &v) != EVAL_OK)
+                return EVAL_FAIL;
+            scope = eval_env_top;
+            status = v ? eval_stmt(s->body, result) : eval_stmt(s->else_body, result);
+            eval_env_top = scope;
+            if (status != EVAL_OK)
+                return status;
+            break;
+        case STMT_FOR:
+            if (s->init_expr && eval_expr(s->init_expr, &v) != EVAL_OK)
+                return EVAL_FAIL;
+            while (1)
+            {
+                if (s->expr)
+                {
+                    if (eval_expr(s->expr, &v) != EVAL_OK)
+                        return EVAL_FAIL;
+                    if (!v)
+                        break;
+                }
+                scope = eval_env_top;
+                status = eval_stmt(s->body, result);
+                eval_env_top = scope;
+                if (status != EVAL_OK)
+                    return status;
+                if (s->next_expr && eval_expr(s->next_expr, &v) != EVAL_OK)
+                    return EVAL_FAIL;
+            }
+            break;
+        default:
+            return EVAL_FAIL;
+        }
+    }
+    return EVAL_OK;
+}
+
+eval_t eval_call(struct decl *d, long *args, int count, long *result)
+{
+    int frame = eval_frame;
+    int top = eval_env_top;
+    int i = 0;
+
+    if (++eval_depth > EVAL_DEPTH_BUDGET)
+        return EVAL_FAIL;
+
+    eval_frame = eval_env_top;
+    for (struct param_list *p = d->type->params; p; p = p->next, i++)
+    {
+        if (i >= count)
+            return EVAL_FAIL;
+        eval_bind(p->name, args[i]);
+    }
+
+    *result = 0;
+    eval_t status = eval_stmt(d->code, result);
+
+    eval_frame = frame;
+    eval_env_top = top;
+    eval_depth--;
+
+    if (status == EVAL_FAIL)
+        return EVAL_FAIL;
+    if (status != EVAL_RETURN)
+        return EVAL_FAIL; // fell off the end without a value
+    return EVAL_OK;
+}
+
+void eval_fold_expr(struct expr *e, int report)
+{ // replaces calls of pure functions on constant arguments with their result
+    if (!e)
+        return;
+
+    eval_fold_expr(e->left, report);
+    eval_fold_expr(e->right, report);
+    eval_fold_expr(e->next, report);
+
+    if (e->kind != EXPR_CALL || !eval_is_constant(e))
+        return;
+
+    long v;
+    struct eval_function *f = hash_table_lookup(eval_functions, e->left->name);
+    if (!eval_constant(e, &v) || v < INT_MIN || v > INT_MAX)
+        return; // literals only hold an int
+
+    if (report)
+        fprintf(stderr, "eval: call of %s computed at compile time as %ld\n", e->left->name, v);
+
+    switch (f->decl->type->subtype->kind)
+    {
+    case TYPE_BOOLEAN:
+        e->kind = EXPR_BOOL_LITERAL;
+        v = v != 0;
+        break;
+    case TYPE_CHARACTER:
+        e->kind = EXPR_CHAR_LITERAL;
+        v = (char)v;
+        break;
+    default:
+        e->kind = EXPR_INT_LITERAL;
+    }
+    e->literal_value = v;
+    e->left = 0;
+    e->right = 0;
+    e->symbol = 0;
+}
+
+void eval_fold_stmt(struct stmt *s, int report)
+{
+    if (!s)
+        return;
+    if (s->decl)
+        eval_fold_expr(s->decl->value, report);
+    eval_fold_expr(s->init_expr, report);
+    eval_fold_expr(s->expr, report);
+    eval_fold_expr(s->next_expr, report);
+    eval_fold_stmt(s->body, report);
+    eval_fold_stmt(s->else_body, report);
+    eval_fold_stmt(s->next, report);
+}
+
+void eval_fold_program(struct decl *program, int report)
+{
+    eval_analyze(program);
+    for (struct decl *d = program; d; d = d->next)
+    {
+        eval_fold_expr(d->value, report);
+        eval_fold_stmt(d->code, report);
+    }
+}
@@ -0,0 +1,31 @@
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+
+/* limits on the work done for a single compile-time evaluation */
+#define EVAL_STEP_BUDGET 10000000
+#define EVAL_DEPTH_BUDGET 2000
+
+typedef enum {
+	EVAL_OK,
+	EVAL_RETURN,
+	EVAL_FAIL
+} eval_t;
+
+void eval_analyze(struct decl *program);
+int eval_is_pure(const char *name);
+int eval_is_constant(struct expr *e);
+int eval_constant(struct expr *e, long *result);
+
+eval_t eval_expr(struct expr *e, long *result);
+eval_t eval_stmt(struct stmt *s, long *result);
+eval_t eval_call(struct decl *d, long *args, int count, long *result);
+
+void eval_fold_expr(struct expr *e, int report);
+void eval_fold_stmt(struct stmt *s, int report);
+void eval_fold_program(struct decl *program, int report);
+
+#endif
@@ -3,7 +3,10 @@
 #include "scratch.c"
 #include "label.h"
 #include "library.h"
+#include "callgraph.h"
+#include "range.h"
 #include <string.h>
+#include <limits.h>
 
 extern int typerr;
 extern int reserr;
@@ -73,6 +76,30 @@ struct expr *expr_create_integer_literal(int value)
     return e;
 }
 
+struct expr *expr_create_array_literal()
+{
+    struct expr *e = expr_create(EXPR_ARRAY_LITERAL, 0, 0);
+    e->elements = calloc(1, sizeof(*e->elements));
+    return e;
+}
+
+void expr_array_append(struct expr *array, struct expr *element)
+{ // keeps only the value of the element, the node itself is freed
+    struct expr_elements *v = array->elements;
+    if (v->count == v->capacity)
+    {
+        v->capacity = v->capacity ? v->capacity * 2 : 16;
+        v->values = realloc(v->values, v->capacity * sizeof(*v->values));
+    }
+    long value = 0;
+    if (!v->count)
+        v->kind = element->kind;
+    if (element->kind != v->kind || !expr_literal(element, &value))
+        v->mismatched = 1;
+    v->values[v->count++] = value;
+    expr_delete(element);
+}
+
 void expr_print(struct expr *e)
 {
     if (!e)
@@ -236,6 +263,22 @@ void expr_print(struct expr *e)
         expr_print(e->right);
         printf(")");
         break;
+    case EXPR_ARRAY_LITERAL:
+        printf("{");
+        for (int i = 0; i < e->elements->count; i++)
+        {
+            long value = e->elements->values[i];
+            if (i)
+                printf(", ");
+            if (e->elements->kind == EXPR_CHAR_LITERAL)
+                printf("'%c'", (int)value);
+            else if (e->elements->kind == EXPR_BOOL_LITERAL)
+                printf(value ? "true" : "false");
+            else
+                printf("%li", value);
+        }
+        printf("}");
+        break;
     case EXPR_ARRACC:
         expr_print(e->left);
         printf("[");
@@ -280,6 +323,20 @@ void expr_delete(struct expr *e)
     free(e);
 }
 
+struct expr *expr_copy(struct expr *e)
+{ // deep copy of the tree and the list after it, sharing names, strings and symbols
+    if (!e)
+        return 0;
+    struct expr *c = expr_create(e->kind, expr_copy(e->left), expr_copy(e->right));
+    c->name = e->name;
+    c->literal_value = e->literal_value;
+    c->string_literal = e->string_literal;
+    c->symbol = e->symbol;
+    c->elements = e->elements;
+    c->next = expr_copy(e->next);
+    return c;
+}
+
 int expr_priority(struct expr *e)
 {
     switch (e->kind)
@@ -404,7 +461,13 @@ struct type *expr_typecheck(struct expr *e)
         break;
 
     case EXPR_GROUP:
-        result = type_copy(expr_typecheck(e->right)); // copy the type itself
+        result = type_copy(rt); // already checked above, checking again doubles the work per nesting level
+        break;
+
+    case EXPR_ARRAY_LITERAL:
+        result = type_create(TYPE_ARRAY, 0, 0, e->elements->count);
+        if (e->elements->count && !e->elements->mismatched)
+            result->subtype = type_create(e->elements->kind == EXPR_CHAR_LITERAL ? TYPE_CHARACTER : e->elements->kind == EXPR_BOOL_LITERAL ? TYPE_BOOLEAN : TYPE_INTEGER, 0, 0, 0);
         break;
 
     case EXPR_ASSGN:
@@ -649,6 +712,353 @@ struct type *expr_typecheck(struct expr *e)
     return result;
 }
 
+int expr_need(struct expr *e)
+{ // Sethi-Ullman number: scratch registers needed to evaluate e without spilling
+    if (!e)
+        return 0;
+    if (e->need)
+        return e->need;
+
+    int l, r, n;
+    switch (e->kind)
+    {
+    case EXPR_GROUP:
+    case EXPR_NOT:
+    case EXPR_NEG:
+    case EXPR_ASSGN:
+        n = expr_need(e->right);
+        break;
+    case EXPR_INCR:
+    case EXPR_DECR:
+        n = e->left->symbol ? 1 : expr_need(e->left);
+        break;
+    case EXPR_CALL: // arguments are evaluated one at a time
+        n = 1;
+        for (struct expr *arg = e->right; arg; arg = arg->next)
+        {
+            if (expr_need(arg) > n)
+                n = expr_need(arg);
+        }
+        break;
+    case EXPR_ARRACC:
+        n = expr_need(e->right) > 2 ? expr_need(e->right) : 2;
+        break;
+    default:
+        if (!e->left || !e->right)
+        { // leaves
+            n = 1;
+            break;
+        }
+        l = expr_need(e->left);
+        if (e->kind != EXPR_DIV && e->kind != EXPR_MOD && e->kind != EXPR_EXPO && expr_is_operand(e->right))
+        { // the right side is read in place by the instruction
+            n = l;
+            break;
+        }
+        r = expr_need(e->right);
+        n = l == r ? l + 1 : (l > r ? l : r);
+    }
+    if (n < 1)
+        n = 1;
+    e->need = n;
+    return n;
+}
+
+int expr_can_reorder(struct expr *a, struct expr *b)
+{ // evaluating b before a gives the same result when neither can disturb the other
+    if (!a || !b)
+        return 0;
+    if (a->kind == EXPR_INT_LITERAL || a->kind == EXPR_BOOL_LITERAL || a->kind == EXPR_CHAR_LITERAL || a->kind == EXPR_STRING_LITERAL)
+        return 1;
+    return !expr_has_side_effects(a) && !expr_has_side_effects(b);
+}
+
+void expr_codegen_operands(struct expr *e, FILE *outfile)
+{ // evaluates both operands of a binary operator, the more demanding one first, into e->left->reg and e->right->reg
+    struct expr *first = e->left;
+    struct expr *second = e->right;
+
+    if (expr_need(e->right) > expr_need(e->left) && expr_can_reorder(e->left, e->right))
+    {
+        first = e->right;
+        second = e->left;
+    }
+
+    expr_codegen(first, outfile);
+    if (expr_need(second) > scratch_available())
+    { // not enough registers left, so keep the first value on the stack meanwhile
+        stack_push(scratch_name(first->reg), outfile);
+        scratch_free(first->reg);
+        expr_codegen(second, outfile);
+        first->reg = scratch_alloc();
+        stack_pop(scratch_name(first->reg), outfile);
+    }
+    else
+    {
+        expr_codegen(second, outfile);
+    }
+}
+
+int expr_literal(struct expr *e, long *value)
+{ // true if e is an integer, boolean or character literal, possibly in parentheses
+    while (e && e->kind == EXPR_GROUP)
+        e = e->right;
+    if (!e || (e->kind != EXPR_INT_LITERAL && e->kind != EXPR_BOOL_LITERAL && e->kind != EXPR_CHAR_LITERAL))
+        return 0;
+    if (value)
+        *value = e->literal_value;
+    return 1;
+}
+
+int expr_is_operand(struct expr *e)
+{ // true if an instruction can read e in place, without loading it into a register
+    while (e && e->kind == EXPR_GROUP)
+        e = e->right;
+    if (expr_literal(e, 0))
+        return 1;
+    if (!e || e->kind != EXPR_NAME || !e->symbol || symbol_size(e->symbol) != 8)
+        return 0;
+    switch (e->symbol->type->kind)
+    {
+    case TYPE_ARRAY:
+    case TYPE_FUNCTION:
+        return 0;
+    case TYPE_STRING:
+        return e->symbol->kind != SYMBOL_GLOBAL; // a global string is its own address, which takes a LEAQ
+    }
+    return 1;
+}
+
+const char *expr_operand(struct expr *e)
+{ // immediate or memory operand for e, or 0 when e has to be evaluated into a register
+    long value;
+    if (!expr_is_operand(e))
+        return 0;
+    if (expr_literal(e, &value))
+    {
+        char *str = malloc(24);
+        sprintf(str, "$%li", value);
+        return str;
+    }
+    while (e->kind == EXPR_GROUP)
+        e = e->right;
+    return symbol_codegen(e->symbol);
+}
+
+int expr_same_variable(struct expr *a, struct expr *b)
+{ // true if a and b name the same scalar variable
+    while (a && a->kind == EXPR_GROUP)
+        a = a->right;
+    while (b && b->kind == EXPR_GROUP)
+        b = b->right;
+    if (!a || !b || a->kind != EXPR_NAME || b->kind != EXPR_NAME || !a->symbol || !b->symbol)
+        return 0;
+    return a->symbol->kind == b->symbol->kind && a->symbol->which == b->symbol->which && !strcmp(a->symbol->name, b->symbol->name);
+}
+
+void expr_codegen_binary(struct expr *e, const char *op, int commutative, FILE *outfile)
+{ // two-address ALU instruction, reading one side straight from an immediate or memory when it can
+    struct expr *dst = e->left;
+    struct expr *src = e->right;
+
+    if (!expr_is_operand(src) && commutative && expr_is_operand(dst) && expr_can_reorder(dst, src))
+    {
+        dst = e->right;
+        src = e->left;
+    }
+    if (expr_is_operand(src))
+    {
+        expr_codegen(dst, outfile);
+        fprintf(outfile, "\t%s %s, %s\n", op, expr_operand(src), scratch_name(dst->reg));
+        e->reg = dst->reg;
+        return;
+    }
+
+    expr_codegen_operands(e, outfile);
+    fprintf(outfile, "\t%s %s, %s\n", op, scratch_name(e->right->reg), scratch_name(e->left->reg));
+    e->reg = e->left->reg;
+    scratch_free(e->right->reg);
+}
+
+struct expr *expr_scaled(struct expr *e, int *scale)
+{ // if e is x*1, x*2, x*4 or x*8, returns x and sets scale, otherwise returns 0
+    long value;
+    while (e->kind == EXPR_GROUP)
+        e = e->right;
+    if (e->kind != EXPR_MUL)
+        return 0;
+    if (expr_literal(e->right, &value) && (value == 1 || value == 2 || value == 4 || value == 8))
+    {
+        *scale = value;
+        return e->left;
+    }
+    if (expr_literal(e->left, &value) && (value == 1 || value == 2 || value == 4 || value == 8))
+    {
+        *scale = value;
+        return e->right;
+    }
+    return 0;
+}
+
+int expr_codegen_address(struct expr *e, FILE *outfile)
+{ // computes base + index*scale + disp with a single LEAQ, returns 0 without emitting anything if e has another shape
+    struct expr *sum = e;
+    long disp = 0;
+    int scale = 1;
+
+    if ((e->kind == EXPR_ADD || e->kind == EXPR_SUB) && expr_literal(e->right, &disp))
+    {
+        if (e->kind == EXPR_SUB)
+            disp = -disp;
+        sum = e->left;
+        while (sum->kind == EXPR_GROUP)
+            sum = sum->right;
+    }
+    if (sum->kind != EXPR_ADD || expr_literal(sum->left, 0) || expr_literal(sum->right, 0))
+        return 0;
+
+    struct expr *base = sum->left;
+    struct expr *index = expr_scaled(sum->right, &scale);
+    struct expr *first = base;
+    if (!index && (index = expr_scaled(sum->left, &scale)))
+    {
+        base = sum->right;
+        first = index; // keep the source order of evaluation
+    }
+    if (!index)
+    {
+        if (!disp)
+            return 0; // a plain a + b is a single ADDQ anyway
+        index = sum->right;
+    }
+    if (expr_literal(index, 0))
+        return 0;
+
+    struct expr *second = first == base ? index : base;
+    if (expr_need(first) > scratch_available() || expr_need(second) + 1 > scratch_available())
+        return 0;
+
+    expr_codegen(first, outfile);
+    expr_codegen(second, outfile);
+    if (disp)
+        fprintf(outfile, "\tLEAQ %li", disp);
+    else
+        fprintf(outfile, "\tLEAQ ");
+    fprintf(outfile, "(%s, %s, %d), %s\n", scratch_name(base->reg), scratch_name(index->reg), scale, scratch_name(base->reg));
+    e->reg = base->reg;
+    scratch_free(index->reg);
+    return 1;
+}
+
+expr_t expr_mirror(expr_t kind)
+{ // comparison that holds after swapping the operands of kind
+    switch (kind)
+    {
+    case EXPR_LT:
+        return EXPR_GT;
+    case EXPR_LE:
+        return EXPR_GE;
+    case EXPR_GT:
+        return EXPR_LT;
+    case EXPR_GE:
+        return EXPR_LE;
+    }
+    return kind;
+}
+
+expr_t expr_codegen_compare(struct expr *e, FILE *outfile)
+{ // sets the flags for comparison e and returns the condition to test them with
+    if (expr_literal(e->right, 0) && expr_is_operand(e->left) && !expr_literal(e->left, 0))
+    { // variable against constant needs no register at all
+        fprintf(outfile, "\tCMPQ %s, %s\n", expr_operand(e->right), expr_operand(e->left));
+        return e->kind;
+    }
+    if (expr_is_operand(e->right))
+    {
+        expr_codegen(e->left, outfile);
+        fprintf(outfile, "\tCMPQ %s, %s\n", expr_operand(e->right), scratch_name(e->left->reg));
+        scratch_free(e->left->reg);
+        return e->kind;
+    }
+    if (expr_is_operand(e->left) && expr_can_reorder(e->left, e->right))
+    {
+        expr_codegen(e->right, outfile);
+        fprintf(outfile, "\tCMPQ %s, %s\n", expr_operand(e->left), scratch_name(e->right->reg));
+        scratch_free(e->right->reg);
+        return expr_mirror(e->kind);
+    }
+
+    expr_codegen_operands(e, outfile);
+    fprintf(outfile, "\tCMPQ %s, %s\n", scratch_name(e->right->reg), scratch_name(e->left->reg));
+    scratch_free(e->left->reg);
+    scratch_free(e->right->reg);
+    return e->kind;
+}
+
+const char *expr_codegen_element(struct expr *e, int *regs, FILE *outfile)
+{ // evaluates what addressing array element e needs and returns its memory operand, the registers it holds end up in regs
+    struct symbol *array = e->left->symbol;
+    char *str = malloc(64 + strlen(array->name));
+    int width = symbol_element_size(array);
+    long index;
+    const char *base = array->name;
+
+    const char *address = e->cursor; // kept in a register by the enclosing loop
+
+    regs[0] = regs[1] = -1;
+    if (address && !e->indexed)
+    { // the register follows this very element
+        sprintf(str, "%li(%s)", e->displacement, address);
+        return str;
+    }
+    if (!address && array->kind != SYMBOL_GLOBAL)
+    { // a parameter holds the address of the array
+        regs[0] = scratch_alloc();
+        fprintf(outfile, "\tMOVQ %s, %s\n", symbol_codegen(array), scratch_name(regs[0]));
+        address = scratch_name(regs[0]);
+    }
+    if (address)
+        base = "";
+
+    if (expr_literal(e->right, &index))
+    {
+        if (!address)
+            sprintf(str, "%s+%li", base, index * width);
+        else
+            sprintf(str, "%li(%s)", index * width, address);
+        return str;
+    }
+
+    expr_codegen(e->right, outfile);
+    regs[1] = e->right->reg;
+    sprintf(str, "%s(%s, %s, %i)", base, address ? address : "", scratch_name(regs[1]), width);
+    return str;
+}
+
+void expr_codegen_store(struct expr *e, int effect, FILE *outfile)
+{ // assignment to an array element, the value stays in e->reg unless only the effect is wanted
+    int regs[2];
+    const char *value = 0;
+    int byte = symbol_element_size(e->left->left->symbol) == 1; // chars and booleans are stored a byte each
+
+    if (effect && expr_literal(e->right, 0))
+    {
+        value = expr_operand(e->right);
+        e->reg = -1;
+    }
+    else
+    {
+        expr_codegen(e->right, outfile);
+        value = byte ? scratch_byte_name(e->right->reg) : scratch_name(e->right->reg);
+        e->reg = e->right->reg;
+    }
+    fprintf(outfile, "\t%s %s, %s\n", byte ? "MOVB" : "MOVQ", value, expr_codegen_element(e->left, regs, outfile));
+    if (regs[0] >= 0)
+        scratch_free(regs[0]);
+    if (regs[1] >= 0)
+        scratch_free(regs[1]);
+}
+
 void expr_codegen(struct expr *e, FILE *outfile)
 {
     if (!e)
@@ -657,7 +1067,9 @@ void expr_codegen(struct expr *e, FILE *outfile)
     {
     case EXPR_NAME:
         e->reg = scratch_alloc();
-        if (e->symbol->type->kind != TYPE_STRING || e->symbol->kind != SYMBOL_GLOBAL) {
+        if (symbol_size(e->symbol) == 1) {
+            fprintf(outfile, "\tMOVZBQ %s, %s\n", symbol_codegen(e->symbol), scratch_name(e->reg));
+        } else if (expr_is_operand(e) || e->symbol->kind != SYMBOL_GLOBAL) {
             fprintf(outfile, "\tMOVQ %s, %s\n", symbol_codegen(e->symbol), scratch_name(e->reg));
         } else {
             fprintf(outfile, "\tLEAQ %s, %s\n", symbol_codegen(e->symbol), scratch_name(e->reg));
@@ -675,9 +1087,9 @@ void expr_codegen(struct expr *e, FILE *outfile)
     case EXPR_STRING_LITERAL:
         e->reg = scratch_alloc();
         int strlabel = label_create();
-        fprintf(outfile, ".data\n");
+        fprintf(outfile, "\t.pushsection .data\n"); // returns to whichever text section the code is in
         fprintf(outfile, "%s:\n\t.string %s\n", label_name(strlabel), e->string_literal);
-        fprintf(outfile, ".text\n");
+        fprintf(outfile, "\t.popsection\n");
         fprintf(outfile, "\tLEAQ %s, %s\n", label_name(strlabel), scratch_name(e->reg)); // save string addr into value
         break;
 
@@ -687,68 +1099,95 @@ void expr_codegen(struct expr *e, FILE *outfile)
         break;
 
     case EXPR_SUB:
-        expr_codegen(e->left, outfile);
-        expr_codegen(e->right, outfile);
-        fprintf(outfile, "\tSUBQ %s, %s\n", scratch_name(e->right->reg), scratch_name(e->left->reg));
-        e->reg = e->left->reg;
-        scratch_free(e->right->reg);
+        if (!expr_codegen_address(e, outfile))
+            expr_codegen_binary(e, "SUBQ", 0, outfile);
         break;
 
     case EXPR_ADD:
-        expr_codegen(e->left, outfile);
-        expr_codegen(e->right, outfile);
-        fprintf(outfile, "\tADDQ %s, %s\n", scratch_name(e->left->reg), scratch_name(e->right->reg));
-        e->reg = e->right->reg; // because ADD is a destructive operator
-        scratch_free(e->left->reg);
+        if (!expr_codegen_address(e, outfile))
+            expr_codegen_binary(e, "ADDQ", 1, outfile);
         break;
 
     case EXPR_DIV:
-        // preparing and performing division
-        expr_codegen(e->left, outfile);
-        expr_codegen(e->right, outfile);
-        fprintf(outfile, "\tMOVQ $0, %%rdx\n");                             // clearing rdx
-        fprintf(outfile, "\tMOVQ %s, %%rax\n", scratch_name(e->left->reg)); // moving left reg (dividend) into rax
-        fprintf(outfile, "\tCQTO\n");                                       // sign extend rax to rdx
-        fprintf(outfile, "\tIDIVQ %s\n", scratch_name(e->right->reg));      // doing division operation with divisor as argument
-
-        // Saving division into e->reg
-        scratch_free(e->right->reg);
-        scratch_free(e->left->reg); // don't need either anymore
-        int divres = scratch_alloc();
-        fprintf(outfile, "\tMOVQ %%rax, %s\n", scratch_name(divres)); // placing result into reg
-        e->reg = divres;
-
-        break;
-
-    case EXPR_MOD: // same  as div, but we want remainder instead of quotient
-        expr_codegen(e->left, outfile);
-        expr_codegen(e->right, outfile);
-        fprintf(outfile, "\tMOVQ $0, %%rdx\n");                             // clearing rdx
-        fprintf(outfile, "\tMOVQ %s, %%rax\n", scratch_name(e->left->reg)); // moving left reg into rax
-        fprintf(outfile, "\tCQTO\n");                                       // sign extend rax to rdx
-        fprintf(outfile, "\tIDIVQ %s\n", scratch_name(e->right->reg));      // doing multiply op
-
-        scratch_free(e->right->reg);
-        scratch_free(e->left->reg);
-        int modres = scratch_alloc();
-        fprintf(outfile, "\tMOVQ %%rdx, %s\n", scratch_name(modres)); // placing result into reg
-        e->reg = modres;
-
+    case EXPR_MOD: // IDIVQ leaves the quotient in rax and the remainder in rdx
+        ;;
+        long divisor;
+        if (expr_literal(e->right, &divisor) && divisor > 0 && !(divisor & (divisor - 1)) && range_within(e->left, 0, LONG_MAX))
+        { // a dividend that is never negative divides by a power of two with a shift or a mask
+            expr_codegen(e->left, outfile);
+            if (e->kind == EXPR_MOD)
+                fprintf(outfile, "\tANDQ $%ld, %s\n", divisor - 1, scratch_name(e->left->reg));
+            else if (divisor > 1)
+                fprintf(outfile, "\tSHRQ $%d, %s\n", __builtin_ctzl(divisor), scratch_name(e->left->reg));
+            e->reg = e->left->reg;
+            break;
+        }
+        // with both operands known to fit in 32 unsigned bits, the much faster DIVL gives the same result
+        int narrow = range_within(e->left, 0, UINT_MAX) && range_within(e->right, 0, UINT_MAX);
+        if (expr_is_operand(e->right) && !expr_literal(e->right, 0) && !(narrow && expr_operand(e->right)[0] == '%'))
+        { // the divisor can be read from memory, IDIVQ has no immediate form
+            expr_codegen(e->left, outfile);
+            fprintf(outfile, "\tMOVQ %s, %%rax\n", scratch_name(e->left->reg));
+            if (narrow)
+            {
+                fprintf(outfile, "\tXORL %%edx, %%edx\n");
+                fprintf(outfile, "\tDIVL %s\n", expr_operand(e->right));
+            }
+            else
+            {
+                fprintf(outfile, "\tCQTO\n"); // sign extend rax to rdx
+                fprintf(outfile, "\tIDIVQ %s\n", expr_operand(e->right));
+            }
+        }
+        else
+        {
+            expr_codegen_operands(e, outfile);
+            fprintf(outfile, "\tMOVQ %s, %%rax\n", scratch_name(e->left->reg));
+            if (narrow)
+            {
+                fprintf(outfile, "\tXORL %%edx, %%edx\n");
+                fprintf(outfile, "\tDIVL %s\n", scratch_long_name(e->right->reg));
+            }
+            else
+            {
+                fprintf(outfile, "\tCQTO\n");
+                fprintf(outfile, "\tIDIVQ %s\n", scratch_name(e->right->reg));
+            }
+            scratch_free(e->right->reg);
+        }
+        fprintf(outfile, "\tMOVQ %s, %s\n", e->kind == EXPR_DIV ? "%rax" : "%rdx", scratch_name(e->left->reg));
+        e->reg = e->left->reg;
         break;
 
     case EXPR_MUL:
-        expr_codegen(e->left, outfile);
-        expr_codegen(e->right, outfile);
-
-        // performing multiply
-        fprintf(outfile, "\tMOVQ %s, %%rax\n", scratch_name(e->left->reg)); // moving left operand in rax
-        fprintf(outfile, "\tIMULQ %s\n", scratch_name(e->right->reg));      // multiplying operand by rax
-        scratch_free(e->left->reg);
-        scratch_free(e->right->reg);
-
-        int mulres = scratch_alloc();
-        fprintf(outfile, "\tMOVQ %%rax, %s\n", scratch_name(mulres)); // placing first 64 bits into integer
-        e->reg = mulres;
+        ;;
+        long factor;
+        struct expr *other = e->left;
+        if (!expr_literal(e->right, &factor))
+            other = expr_literal(e->left, &factor) ? e->right : 0;
+        if (!other)
+        { // two-operand IMULQ keeps the low 64 bits, which is all we need, and leaves rax and rdx alone
+            expr_codegen_binary(e, "IMULQ", 1, outfile);
+            break;
+        }
+        expr_codegen(other, outfile);
+        e->reg = other->reg;
+        if (factor > 0 && !(factor & (factor - 1)))
+        {
+            int shift = 0;
+            while ((1L << shift) < factor)
+                shift++;
+            if (shift)
+                fprintf(outfile, "\tSHLQ $%d, %s\n", shift, scratch_name(e->reg));
+        }
+        else if (factor == 3 || factor == 5 || factor == 9)
+        {
+            fprintf(outfile, "\tLEAQ (%s, %s, %li), %s\n", scratch_name(e->reg), scratch_name(e->reg), factor - 1, scratch_name(e->reg));
+        }
+        else
+        {
+            fprintf(outfile, "\tIMULQ $%li, %s, %s\n", factor, scratch_name(e->reg), scratch_name(e->reg));
+        }
         break;
 
     case EXPR_NEG:
@@ -758,7 +1197,9 @@ void expr_codegen(struct expr *e, FILE *outfile)
         break;
 
     case EXPR_DECR:
-        if (e->left->symbol) {
+        if (e->left->symbol) { // value of the expression is the one before decrementing
+            e->reg = scratch_alloc();
+            fprintf(outfile, "\tMOVQ %s, %s\n", symbol_codegen(e->left->symbol), scratch_name(e->reg));
             fprintf(outfile, "\tDECQ %s\n", symbol_codegen(e->left->symbol));
         } else { 
             expr_codegen(e->left, outfile);
@@ -768,7 +1209,9 @@ void expr_codegen(struct expr *e, FILE *outfile)
         break;
 
     case EXPR_INCR:
-        if (e->left->symbol) {
+        if (e->left->symbol) { // value of the expression is the one before incrementing
+            e->reg = scratch_alloc();
+            fprintf(outfile, "\tMOVQ %s, %s\n", symbol_codegen(e->left->symbol), scratch_name(e->reg));
             fprintf(outfile, "\tINCQ %s\n", symbol_codegen(e->left->symbol));
         } else { 
             expr_codegen(e->left, outfile);
@@ -778,34 +1221,30 @@ void expr_codegen(struct expr *e, FILE *outfile)
         break;
 
     case EXPR_AND:
-        expr_codegen(e->left, outfile);
-        expr_codegen(e->right, outfile);
-        fprintf(outfile, "\tANDQ %s, %s\n", scratch_name(e->left->reg), scratch_name(e->right->reg));
-        e->reg = e->right->reg;
+        expr_codegen_binary(e, "ANDQ", 1, outfile);
         break;
 
     case EXPR_OR:
-        expr_codegen(e->left, outfile);
-        expr_codegen(e->right, outfile);
-        fprintf(outfile, "\tORQ %s, %s\n", scratch_name(e->left->reg), scratch_name(e->right->reg));
-        e->reg = e->right->reg;
+        expr_codegen_binary(e, "ORQ", 1, outfile);
         break;
 
-    case EXPR_NOT:
+    case EXPR_NOT: // booleans are always 0 or 1
         expr_codegen(e->right, outfile);
-        int notlabel = label_create();
-        fprintf(outfile, "\tCMP $0, %s\n", scratch_name(e->right->reg));
-        fprintf(outfile, "\tMOVQ $1, %s\n", scratch_name(e->right->reg));
-        fprintf(outfile, "\tJE %s\n", label_name(notlabel));
-        fprintf(outfile, "\tMOVQ $0, %s\n", scratch_name(e->right->reg));
-        fprintf(outfile, "%s:\n", label_name(notlabel));
-
+        fprintf(outfile, "\tXORQ $1, %s\n", scratch_name(e->right->reg));
         e->reg = e->right->reg;
         break;
 
     case EXPR_ASSGN:
+        if (e->left->kind == EXPR_ARRACC) {
+            expr_codegen_store(e, 0, outfile);
+            break;
+        }
         expr_codegen(e->right, outfile);
-        fprintf(outfile, "\tMOVQ %s, %s\n", scratch_name(e->right->reg), symbol_codegen(e->left->symbol)); // using symbol because that's what return would recognize
+        if (symbol_size(e->left->symbol) == 1) {
+            fprintf(outfile, "\tMOVB %s, %s\n", scratch_byte_name(e->right->reg), symbol_codegen(e->left->symbol));
+        } else {
+            fprintf(outfile, "\tMOVQ %s, %s\n", scratch_name(e->right->reg), symbol_codegen(e->left->symbol)); // using symbol because that's what return would recognize
+        }
         e->reg = e->right->reg;
         break;
 
@@ -815,112 +1254,439 @@ void expr_codegen(struct expr *e, FILE *outfile)
     case EXPR_GT:
     case EXPR_LE:
     case EXPR_LT:
-        expr_codegen(e->left, outfile);
-        expr_codegen(e->right, outfile);
-        fprintf(outfile, "\tCMP %s, %s\n", scratch_name(e->right->reg), scratch_name(e->left->reg));
+        ;;
+        expr_t cond = expr_codegen_compare(e, outfile);
+        e->reg = scratch_alloc();
+        fprintf(outfile, "\tSET%s %s\n", expr_jump_name(cond, 1) + 1, scratch_byte_name(e->reg)); // SETcc shares the condition suffix of Jcc
+        fprintf(outfile, "\tMOVZBQ %s, %s\n", scratch_byte_name(e->reg), scratch_name(e->reg));
+        break;
 
+    case EXPR_EXPO: // becomes a call to integer_power from the library
+        expr_codegen_operands(e, outfile);
+        fprintf(outfile, "\tMOVQ %s, %%rdi\n", scratch_name(e->left->reg));
+        fprintf(outfile, "\tMOVQ %s, %%rsi\n", scratch_name(e->right->reg));
         scratch_free(e->left->reg);
         scratch_free(e->right->reg);
-        int eqres = scratch_alloc();
-        int truelabel = label_create();
+        scratch_call("integer_power", outfile);
+        e->reg = scratch_alloc();
+        fprintf(outfile, "\tMOVQ %%rax, %s\n", scratch_name(e->reg));
+        break;
 
-        fprintf(outfile, "\tMOVQ $1, %s\n", scratch_name(eqres)); // setting result to true by default
-        switch (e->kind)
-        {
-        case EXPR_EQ:
-            fprintf(outfile, "\tJE %s\n", label_name(truelabel));
-            break;
-        case EXPR_NEQ:
-            fprintf(outfile, "\tJNE %s\n", label_name(truelabel));
-            break;
-        case EXPR_GE:
-            fprintf(outfile, "\tJGE %s\n", label_name(truelabel));
-            break;
-        case EXPR_GT:
-            fprintf(outfile, "\tJG %s\n", label_name(truelabel));
-            break;
-        case EXPR_LE:
-            fprintf(outfile, "\tJLE %s\n", label_name(truelabel));
-            break;
-        case EXPR_LT:
-            fprintf(outfile, "\tJL %s\n", label_name(truelabel));
-            break;
+    case EXPR_CALL:
+        ;;
+        // functions defined here take the internal convention: a seventh register argument and every scratch register clobbered
+        struct callgraph_node *callee = callgraph_lookup(e->left->name);
+        int internal = callee && callee->decl->type->kind == TYPE_FUNCTION && callee->decl->code;
+        const char *target = internal ? decl_body_name(callee->decl) : e->left->name;
+        int nregs = internal ? ARGS_INTERNAL : ARGS_SYSTEM_V;
+
+        // values live across the call move to the stack first, which also frees their registers for the arguments
+        int saved = scratch_save(internal, outfile);
+
+        int count = 0;
+        for (struct expr *arg = e->right; arg; arg = arg->next)
+            count++;
+        struct expr **args = malloc((count + 1) * sizeof(*args));
+        int *temps = malloc((count + 1) * sizeof(*temps)); // scratch register holding each argument, or where it waits otherwise
+        count = 0;
+        for (struct expr *arg = e->right; arg; arg = arg->next)
+            args[count++] = arg;
+
+        // arguments past the registers go into an area at the bottom of the stack, padded so the call is aligned
+        int area = count > nregs ? (count - nregs) * 8 : 0;
+        if ((stack_depth + area) % 16)
+            area += 8;
+        if (area) {
+            fprintf(outfile, "\tSUBQ $%i, %%rsp\n", area);
+            stack_depth += area;
         }
-        fprintf(outfile, "\tMOVQ $0, %s\n", scratch_name(eqres)); // setting to false if not skipped over
-        fprintf(outfile, "%s:\n", label_name(truelabel));         // skips over false if true, executes movq0 if false
 
-        e->reg = eqres;
+        // every argument is evaluated before any argument register is written, so nested calls cannot clobber them
+        int pushed = 0;
+        for (int i = 0; i < count; i++) {
+            int later_effects = 0;
+            for (int j = i + 1; j < count; j++)
+                later_effects |= expr_has_side_effects(args[j]);
+            if (i < nregs && expr_is_operand(args[i]) && !later_effects) {
+                temps[i] = EXPR_ARG_IN_PLACE; // read straight into its argument register at the end
+                continue;
+            }
+            for (int j = 0; j < i && expr_need(args[i]) > scratch_available(); j++) {
+                if (temps[j] >= 0) { // out of registers, park the oldest argument on the stack
+                    stack_push(scratch_name(temps[j]), outfile);
+                    scratch_free(temps[j]);
+                    temps[j] = EXPR_ARG_PUSHED;
+                    pushed++;
+                }
+            }
+            if (i >= nregs && expr_literal(args[i], 0)) {
+                fprintf(outfile, "\tMOVQ %s, %i(%%rsp)\n", expr_operand(args[i]), (i - nregs + pushed) * 8);
+                temps[i] = EXPR_ARG_STORED;
+                continue;
+            }
+            expr_codegen(args[i], outfile);
+            temps[i] = args[i]->reg;
+            if (i >= nregs) {
+                fprintf(outfile, "\tMOVQ %s, %i(%%rsp)\n", scratch_name(temps[i]), (i - nregs + pushed) * 8);
+                scratch_free(temps[i]);
+                temps[i] = EXPR_ARG_STORED;
+            }
+        }
+
+        for (int i = 0; i < count && i < nregs; i++) {
+            if (temps[i] == EXPR_ARG_IN_PLACE) {
+                fprintf(outfile, "\tMOVQ %s, %s\n", expr_operand(args[i]), arg_name(i));
+            } else if (temps[i] >= 0) {
+                fprintf(outfile, "\tMOVQ %s, %s\n", scratch_name(temps[i]), arg_name(i));
+                scratch_free(temps[i]);
+            }
+        }
+        for (int i = count - 1; i >= 0; i--) { // pushed in argument order, so popped in reverse
+            if (temps[i] == EXPR_ARG_PUSHED)
+                stack_pop(arg_name(i), outfile);
+        }
+        free(args);
+        free(temps);
+
+        fprintf(outfile, "\tCALL %s\n", target);
+        if (area) {
+            fprintf(outfile, "\tADDQ $%i, %%rsp\n", area);
+            stack_depth -= area;
+        }
+        scratch_restore(saved, outfile);
+        e->reg = scratch_alloc();
+        fprintf(outfile, "\tMOVQ %%rax, %s\n", scratch_name(e->reg)); // moving result into scratch register
         break;
 
-    case EXPR_EXPO: //essentially modifing the tree as to create a function call to integer_power. saves us the writing pre-and post-ambles
-        expr_codegen(e->left, outfile);
-        expr_codegen(e->right, outfile);
-        
-        fprintf(outfile, "\tPUSHQ %%r10\n");
-        fprintf(outfile, "\tPUSHQ %%r11\n");
-        fprintf(outfile, "\tPUSHQ %%rdi\n");
-        fprintf(outfile, "\tPUSHQ %%rsi\n");
+    case EXPR_ARRACC:
+        ;;
+        int regs[2];
+        const char *element = expr_codegen_element(e, regs, outfile);
+        e->reg = regs[0] >= 0 ? regs[0] : (regs[1] >= 0 ? regs[1] : scratch_alloc()); // the result reuses an address register
+        fprintf(outfile, "\t%s %s, %s\n", symbol_element_size(e->left->symbol) == 1 ? "MOVZBQ" : "MOVQ", element, scratch_name(e->reg));
+        if (regs[1] >= 0 && regs[1] != e->reg)
+            scratch_free(regs[1]);
+        break;
+    }
+}
 
-        fprintf(outfile, "\tMOVQ %s, %%rdi\n", scratch_name(e->left->reg));
-        fprintf(outfile, "\tMOVQ %s, %%rsi\n", scratch_name(e->right->reg));
-        fprintf(outfile, "\tCALL integer_power\n");
+void expr_codegen_effect(struct expr *e, FILE *outfile)
+{ // generates e only for its side effects, the value is thrown away
+    if (!e)
+        return;
+    if ((e->kind == EXPR_INCR || e->kind == EXPR_DECR) && e->left->symbol)
+    {
+        fprintf(outfile, "\t%s %s\n", e->kind == EXPR_INCR ? "INCQ" : "DECQ", symbol_codegen(e->left->symbol));
+        return;
+    }
+    if (e->kind == EXPR_ASSGN && e->left->kind == EXPR_ARRACC)
+    {
+        expr_codegen_store(e, 1, outfile);
+        if (e->reg >= 0)
+            scratch_free(e->reg);
+        return;
+    }
+    if (e->kind == EXPR_ASSGN && expr_is_operand(e->left))
+    { // the value is not needed, so update the variable in memory
+        const char *dest = symbol_codegen(e->left->symbol);
+        struct expr *r = e->right;
+        struct expr *other = 0;
+        while (r->kind == EXPR_GROUP)
+            r = r->right;
+        if (expr_literal(r, 0))
+        {
+            fprintf(outfile, "\tMOVQ %s, %s\n", expr_operand(r), dest);
+            return;
+        }
+        if ((r->kind == EXPR_ADD || r->kind == EXPR_SUB) && expr_same_variable(r->left, e->left))
+            other = r->right;
+        else if (r->kind == EXPR_ADD && expr_same_variable(r->right, e->left))
+            other = r->left;
+        if (other && !expr_has_side_effects(other))
+        { // x = x + y reads x before y, so y must not be able to change it
+            const char *op = r->kind == EXPR_ADD ? "ADDQ" : "SUBQ";
+            if (expr_literal(other, 0))
+            {
+                fprintf(outfile, "\t%s %s, %s\n", op, expr_operand(other), dest);
+            }
+            else
+            {
+                expr_codegen(other, outfile);
+                fprintf(outfile, "\t%s %s, %s\n", op, scratch_name(other->reg), dest);
+                scratch_free(other->reg);
+            }
+            return;
+        }
+    }
+    expr_codegen(e, outfile);
+    scratch_free(e->reg);
+}
 
-        fprintf(outfile, "\tPOPQ %%rsi\n");
-        fprintf(outfile, "\tPOPQ %%rdi\n");
-        fprintf(outfile, "\tPOPQ %%r11\n");
-        fprintf(outfile, "\tPOPQ %%r10\n");
+int expr_has_side_effects(struct expr *e)
+{ // true if evaluating e can change a variable or produce output
+    if (!e)
+        return 0;
+    switch (e->kind)
+    {
+    case EXPR_ASSGN:
+    case EXPR_INCR:
+    case EXPR_DECR:
+    case EXPR_CALL:
+        return 1;
+    }
+    return expr_has_side_effects(e->left) || expr_has_side_effects(e->right);
+}
 
-        scratch_free(e->left->reg);
-        scratch_free(e->right->reg);
+const char *expr_jump_name(expr_t kind, int when)
+{ // conditional jump taken when the comparison kind has the truth value when
+    switch (kind)
+    {
+    case EXPR_EQ:
+        return when ? "JE" : "JNE";
+    case EXPR_NEQ:
+        return when ? "JNE" : "JE";
+    case EXPR_LT:
+        return when ? "JL" : "JGE";
+    case EXPR_LE:
+        return when ? "JLE" : "JG";
+    case EXPR_GT:
+        return when ? "JG" : "JLE";
+    case EXPR_GE:
+        return when ? "JGE" : "JL";
+    }
+    return 0;
+}
 
-        int expres = scratch_alloc();
-        fprintf(outfile, "\tMOVQ %%rax, %s\n", scratch_name(expres));
-                
-        break;
+expr_t expr_negate(expr_t kind)
+{ // comparison that holds exactly when kind does not
+    switch (kind)
+    {
+    case EXPR_EQ:
+        return EXPR_NEQ;
+    case EXPR_NEQ:
+        return EXPR_EQ;
+    case EXPR_LT:
+        return EXPR_GE;
+    case EXPR_LE:
+        return EXPR_GT;
+    case EXPR_GT:
+        return EXPR_LE;
+    case EXPR_GE:
+        return EXPR_LT;
+    }
+    return kind;
+}
+
+expr_t expr_codegen_condition(struct expr *e, FILE *outfile)
+{ // sets the flags from boolean e and returns the condition that holds when e is true
+    switch (e->kind)
+    {
+    case EXPR_GROUP:
+        return expr_codegen_condition(e->right, outfile);
+    case EXPR_NOT:
+        return expr_negate(expr_codegen_condition(e->right, outfile));
+    case EXPR_EQ:
+    case EXPR_NEQ:
+    case EXPR_LT:
+    case EXPR_LE:
+    case EXPR_GT:
+    case EXPR_GE:
+        return expr_codegen_compare(e, outfile);
+    }
+    expr_codegen(e, outfile);
+    fprintf(outfile, "\tCMPQ $0, %s\n", scratch_name(e->reg));
+    scratch_free(e->reg);
+    return EXPR_NEQ;
+}
+
+int expr_equal(struct expr *a, struct expr *b)
+{ // true if a and b are the same expression tree
+    if (!a || !b)
+        return a == b;
+    if (a->kind != b->kind)
+        return 0;
+    switch (a->kind)
+    {
+    case EXPR_NAME:
+        return expr_same_variable(a, b);
+    case EXPR_INT_LITERAL:
+    case EXPR_BOOL_LITERAL:
+    case EXPR_CHAR_LITERAL:
+        return a->literal_value == b->literal_value;
+    case EXPR_STRING_LITERAL:
+        return !strcmp(a->string_literal, b->string_literal);
+    }
+    return expr_equal(a->left, b->left) && expr_equal(a->right, b->right);
+}
+
+int expr_contains(struct expr *e, struct expr *part)
+{ // true if part occurs somewhere inside e
+    if (!e)
+        return 0;
+    if (expr_equal(e, part))
+        return 1;
+    return expr_contains(e->left, part) || expr_contains(e->right, part) || expr_contains(e->next, part);
+}
+
+int expr_can_speculate(struct expr *e, struct expr *guard)
+{ // true if e can be evaluated even where the program would not have, because it cannot fault or change anything
+    if (!e)
+        return 1;
+    switch (e->kind)
+    {
+    case EXPR_ASSGN:
+    case EXPR_INCR:
+    case EXPR_DECR:
     case EXPR_CALL:
-        // saving caller saved registers
-        fprintf(outfile, "\tPUSHQ %%r10\n");
-        fprintf(outfile, "\tPUSHQ %%r11\n");
-        // saving all arguments into arg registers
-        struct expr* eptr = e->right; // eptr will be pointing to the expression
-        struct expr* func = e->left;
-        int i = 0;
-        while (eptr) {
-            expr_codegen(eptr, outfile); // passing by value, not reference
-            
-            fprintf(outfile, "\tMOVQ %s, %s\n", scratch_name(eptr->reg), arg_name(i));
-
-            scratch_free(eptr->reg);
-            if (eptr->next) {
-                eptr = eptr->next;
-                i++;
-            } else {
-                break;
+    case EXPR_DIV:
+    case EXPR_MOD:
+    case EXPR_EXPO:
+        return 0;
+    case EXPR_ARRACC: // the element is only known to exist if guard reads it as well
+        return expr_contains(guard, e) && expr_can_speculate(e->right, guard);
+    }
+    return expr_can_speculate(e->left, guard) && expr_can_speculate(e->right, guard);
+}
+
+int expr_size(struct expr *e)
+{ // number of nodes in the tree
+    if (!e)
+        return 0;
+    return 1 + expr_size(e->left) + expr_size(e->right);
+}
+
+void expr_codegen_branch(struct expr *e, int label, int when, FILE *outfile)
+{ // jumps to label when the truth value of e equals when, falls through otherwise
+    switch (e->kind)
+    {
+    case EXPR_GROUP:
+        expr_codegen_branch(e->right, label, when, outfile);
+        return;
+    case EXPR_NOT:
+        expr_codegen_branch(e->right, label, !when, outfile);
+        return;
+    case EXPR_BOOL_LITERAL:
+        if (e->literal_value == when)
+            fprintf(outfile, "\tJMP %s\n", label_name(label));
+        return;
+    case EXPR_EQ:
+    case EXPR_NEQ:
+    case EXPR_LT:
+    case EXPR_LE:
+    case EXPR_GT:
+    case EXPR_GE:
+        ;; // compare and branch on the flags directly instead of materializing a boolean
+        expr_t cond = expr_codegen_compare(e, outfile);
+        fprintf(outfile, "\t%s %s\n", expr_jump_name(cond, when), label_name(label));
+        return;
+    case EXPR_AND:
+    case EXPR_OR:
+        if (expr_has_side_effects(e->right))
+            break; // the right side must still run, so evaluate both as a value
+        if ((e->kind == EXPR_AND) != when)
+        { // the left side alone can decide the jump
+            expr_codegen_branch(e->left, label, when, outfile);
+            expr_codegen_branch(e->right, label, when, outfile);
+        }
+        else
+        {
+            int skip = label_create();
+            expr_codegen_branch(e->left, skip, !when, outfile);
+            expr_codegen_branch(e->right, label, when, outfile);
+            fprintf(outfile, "%s:\n", label_name(skip));
+        }
+        return;
+    }
+
+    expr_codegen(e, outfile);
+    fprintf(outfile, "\tCMPQ $0, %s\n", scratch_name(e->reg));
+    fprintf(outfile, "\t%s %s\n", when ? "JNE" : "JE", label_name(label));
+    scratch_free(e->reg);
+}
+
+int expr_print_constant(struct expr *e)
+{ // literals whose printed text is known at compile time can be folded into a print descriptor
+    if (!e)
+        return 0;
+    switch (e->kind)
+    {
+    case EXPR_INT_LITERAL:
+    case EXPR_BOOL_LITERAL:
+        return 1;
+    case EXPR_CHAR_LITERAL: // bytes 0 to 4 end the descriptor or mean an item
+        return e->literal_value < 0 || e->literal_value > PRINT_ITEM_STRING;
+    case EXPR_STRING_LITERAL:
+        // a numeric escape may spell \0 or the byte of an item kind, so those strings stay runtime items
+        for (const char *c = e->string_literal; *c; c++)
+        {
+            if (*c == '\\')
+            {
+                c++;
+                if ((*c >= '0' && *c <= '9') || *c == 'x')
+                    return 0;
+                if (!*c)
+                    break;
             }
         }
+        return 1;
+    case EXPR_GROUP:
+        return expr_print_constant(e->right);
+    }
+    return 0;
+}
 
-        // calling function
-        fprintf(outfile, "\tCALL %s\n", e->left->name);
-        // restoring caller saved registers
-        fprintf(outfile, "\tPOPQ %%r11\n");
-        fprintf(outfile, "\tPOPQ %%r10\n");
+void expr_print_descriptor(struct expr *e, FILE *outfile)
+{ // writes the part of a print_items descriptor (inside a .string directive) that stands for e
+    if (!expr_print_constant(e))
+    {
+        struct type *t = expr_typecheck(e);
+        switch (t->kind)
+        {
+        case TYPE_INTEGER:
+            fprintf(outfile, "\\%03o", PRINT_ITEM_INTEGER);
+            break;
+        case TYPE_BOOLEAN:
+            fprintf(outfile, "\\%03o", PRINT_ITEM_BOOLEAN);
+            break;
+        case TYPE_CHARACTER:
+            fprintf(outfile, "\\%03o", PRINT_ITEM_CHARACTER);
+            break;
+        case TYPE_STRING:
+            fprintf(outfile, "\\%03o", PRINT_ITEM_STRING);
+            break;
+        }
+        type_delete(t);
+        return;
+    }
 
-        int callres = scratch_alloc();
-        fprintf(outfile, "\tMOVQ %%rax, %s\n", scratch_name(callres)); // moving result into scratch register
-        e->reg = callres;
+    switch (e->kind)
+    {
+    case EXPR_INT_LITERAL:
+        fprintf(outfile, "%d", e->literal_value);
+        break;
+    case EXPR_BOOL_LITERAL:
+        fprintf(outfile, "%s", e->literal_value ? "true" : "false");
+        break;
+    case EXPR_CHAR_LITERAL:
+        if (e->literal_value == '"' || e->literal_value == '\\')
+        {
+            fprintf(outfile, "\\%c", e->literal_value);
+        }
+        else if (e->literal_value < ' ' || e->literal_value > '~')
+        {
+            fprintf(outfile, "\\%03o", (unsigned char)e->literal_value);
+        }
+        else
+        {
+            fprintf(outfile, "%c", e->literal_value);
+        }
+        break;
+    case EXPR_STRING_LITERAL:
+        // source escapes are the same as the assembler's, so only the quotes need stripping
+        fprintf(outfile, "%.*s", (int)strlen(e->string_literal) - 2, e->string_literal + 1);
+        break;
+    case EXPR_GROUP:
+        expr_print_descriptor(e->right, outfile);
         break;
-    
-
-    case EXPR_ARRACC:
-        ;;
-        int returned = scratch_alloc();
-        int start_address = scratch_alloc();
-        expr_codegen(e->right, outfile);
-        fprintf(outfile, "\tLEAQ %s, %s\n", e->left->name, scratch_name(start_address));
-        fprintf(outfile, "\tMOVQ (%s, %s, 8), %s\n", scratch_name(start_address), scratch_name(e->right->reg), scratch_name(returned));
-        e->reg = returned;
-        scratch_free(e->right->reg);
-        scratch_free(start_address);
-    
     }
 }
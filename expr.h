@@ -6,6 +6,11 @@
 #include "misc.h"
 #include "library.h"
 
+/* where a call argument waits while the others are evaluated, when not in a scratch register */
+#define EXPR_ARG_IN_PLACE -1
+#define EXPR_ARG_PUSHED -2
+#define EXPR_ARG_STORED -3
+
 typedef enum {
 	EXPR_ASSGN,
 	EXPR_OR,
@@ -33,10 +38,20 @@ typedef enum {
 	EXPR_NAME,
 	EXPR_CALL,
 	EXPR_ARRACC,
-	EXPR_GROUP
+	EXPR_GROUP,
+	EXPR_ARRAY_LITERAL
 	/* many more kinds of exprs to add here */
 } expr_t;
 
+/* elements of an array initializer, kept in one vector rather than a list of nodes so tables of millions of entries stay cheap */
+struct expr_elements {
+	long *values;
+	int count;
+	int capacity;
+	expr_t kind;      // literal kind every element has
+	int mismatched;   // some element was not a literal of that kind
+};
+
 struct expr {
 	/* used by all kinds of exprs */
 	expr_t kind;
@@ -48,9 +63,19 @@ struct expr {
 	int literal_value;
 	const char * string_literal;
 	struct symbol *symbol;
+	struct expr_elements *elements; // values of an EXPR_ARRAY_LITERAL
 
 	/* used by code generation function*/
 	int reg;
+	int need;
+	int ranged;       // low and high hold the values e can take, found by range analysis
+	long low;
+	long high;
+
+	/* set while a loop keeps the address of this array element, or with indexed of its array, in a register */
+	const char *cursor;
+	long displacement;
+	int indexed;
     struct expr* next;
 };
 
@@ -62,9 +87,12 @@ struct expr * expr_create_integer_literal( int c );
 struct expr * expr_create_boolean_literal( int c );
 struct expr * expr_create_char_literal( char c );
 struct expr * expr_create_string_literal( const char *str );
+struct expr * expr_create_array_literal();
+void expr_array_append( struct expr *array, struct expr *element );
 
 void expr_print( struct expr *e);
 void expr_delete (struct expr* e);
+struct expr* expr_copy(struct expr* e);
 void exprs_print(struct expr* e, int indent);
 
 int expr_priority(struct expr* e);
@@ -75,5 +103,31 @@ void exprs_resolve(struct expr* e);
 struct type* expr_typecheck(struct expr* e);
 
 void expr_codegen(struct expr* e, FILE* outfile);
+int expr_need(struct expr* e);
+int expr_can_reorder(struct expr* a, struct expr* b);
+void expr_codegen_operands(struct expr* e, FILE* outfile);
+int expr_literal(struct expr* e, long* value);
+int expr_is_operand(struct expr* e);
+const char* expr_operand(struct expr* e);
+int expr_same_variable(struct expr* a, struct expr* b);
+void expr_codegen_binary(struct expr* e, const char* op, int commutative, FILE* outfile);
+int expr_codegen_address(struct expr* e, FILE* outfile);
+expr_t expr_mirror(expr_t kind);
+expr_t expr_codegen_compare(struct expr* e, FILE* outfile);
+const char* expr_codegen_element(struct expr* e, int* regs, FILE* outfile);
+void expr_codegen_store(struct expr* e, int effect, FILE* outfile);
+void expr_codegen_branch(struct expr* e, int label, int when, FILE* outfile);
+void expr_codegen_effect(struct expr* e, FILE* outfile);
+int expr_has_side_effects(struct expr* e);
+const char* expr_jump_name(expr_t kind, int when);
+expr_t expr_negate(expr_t kind);
+expr_t expr_codegen_condition(struct expr* e, FILE* outfile);
+int expr_equal(struct expr* a, struct expr* b);
+int expr_contains(struct expr* e, struct expr* part);
+int expr_can_speculate(struct expr* e, struct expr* guard);
+int expr_size(struct expr* e);
+
+int expr_print_constant(struct expr* e);
+void expr_print_descriptor(struct expr* e, FILE* outfile);
 
 #endif
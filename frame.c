@@ -0,0 +1,87 @@
+#include "frame.h"
+#include "scratch.h"
+
+int frame_assign(struct symbol* s, int top) {
+    // places s right below top, aligned to its own size, and returns the new top
+    int size = symbol_size(s);
+    top = (top + size - 1) / size * size + size;
+    s->offset = -top;
+    return top;
+}
+
+int frame_layout_stmts(struct stmt* s, int top) {
+    // lays out the locals of one scope below top and every nested scope below those, returns the deepest byte used
+    struct stmt* p;
+    struct decl* d;
+
+    // all words first and then all bytes, so the bytes pack without padding between them
+    for (p = s; p; p = p->next) {
+        if (p->kind != STMT_DECL) continue;
+        for (d = p->decl; d; d = d->next) {
+            if (symbol_size(d->symbol) == 8) top = frame_assign(d->symbol, top);
+        }
+    }
+    for (p = s; p; p = p->next) {
+        if (p->kind != STMT_DECL) continue;
+        for (d = p->decl; d; d = d->next) {
+            if (symbol_size(d->symbol) == 1) top = frame_assign(d->symbol, top);
+        }
+    }
+
+    // sibling scopes are never live at the same time, so each one starts again at top
+    int deepest = top;
+    for (p = s; p; p = p->next) {
+        int depth = top;
+        switch (p->kind) {
+            case STMT_BLOCK:
+            case STMT_FOR:
+                depth = frame_layout_stmts(p->body, top);
+                break;
+            case STMT_IF_ELSE:
+                depth = frame_layout_stmts(p->body, top);
+                int other = frame_layout_stmts(p->else_body, top);
+                if (other > depth) depth = other;
+                break;
+        }
+        if (depth > deepest) deepest = depth;
+    }
+    return deepest;
+}
+
+int frame_expr_uses(struct expr* e, expr_t kind) {
+    // true if e contains an expression of the given kind
+    if (!e) return 0;
+    if (e->kind == kind) return 1;
+    return frame_expr_uses(e->next, kind) || frame_expr_uses(e->left, kind) || frame_expr_uses(e->right, kind);
+}
+
+int frame_stmt_uses(struct stmt* s, expr_t kind) {
+    // same for a statement list, where print counts as a call
+    for (; s; s = s->next) {
+        if (kind == EXPR_CALL && s->kind == STMT_PRINT) return 1;
+        if (s->decl && frame_expr_uses(s->decl->value, kind)) return 1;
+        if (frame_expr_uses(s->init_expr, kind) || frame_expr_uses(s->expr, kind) || frame_expr_uses(s->next_expr, kind)) return 1;
+        if (frame_stmt_uses(s->body, kind) || frame_stmt_uses(s->else_body, kind)) return 1;
+    }
+    return 0;
+}
+
+int frame_layout(struct decl* d) {
+    // gives every parameter and local of function d its place, returns the bytes the frame needs below %rbp
+    int leaf = !frame_stmt_uses(d->code, EXPR_CALL) && !frame_stmt_uses(d->code, EXPR_EXPO);
+    int divides = frame_stmt_uses(d->code, EXPR_DIV) || frame_stmt_uses(d->code, EXPR_MOD);
+    int top = 0;
+    int i = 0;
+    for (struct param_list* p = d->type->params; p; p = p->next, i++) {
+        p->symbol->reg = 0;
+        if (i >= ARGS_INTERNAL) {
+            p->symbol->offset = 16 + (i - ARGS_INTERNAL) * 8; // pushed by the caller, above the return address
+        } else if (leaf && !(divides && (i == 2 || i == 6))) {
+            p->symbol->reg = arg_name(i); // nothing in a leaf overwrites it, except IDIVQ with rdx and rax
+        } else {
+            top = frame_assign(p->symbol, top); // pushed in order right after %rbp
+        }
+    }
+    top = frame_layout_stmts(d->code, top);
+    return (top + 7) / 8 * 8;
+}
@@ -0,0 +1,13 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+#include "decl.h"
+#include "stmt.h"
+
+int frame_layout(struct decl* d);
+int frame_layout_stmts(struct stmt* s, int top);
+int frame_assign(struct symbol* s, int top);
+int frame_expr_uses(struct expr* e, expr_t kind);
+int frame_stmt_uses(struct stmt* s, expr_t kind);
+
+#endif
@@ -0,0 +1,348 @@
+#include "icf.h"
+#include "callgraph.h"
+#include "scratch.h"
+#include "symbol.h"
+#include "type.h"
+#include <string.h>
+#include <ctype.h>
+
+struct icf_function* icf_functions = 0; // every function emitted so far, by its canonical code
+int icf_count = 0;
+int icf_capacity = 0;
+
+int icf_report = 0;      // whether folds are reported, set by icf_merge_program
+
+char* icf_text = 0;
+size_t icf_size = 0;
+
+FILE* icf_begin() {
+    // a function is generated into memory first, so a copy of one already emitted can be left out
+    return open_memstream(&icf_text, &icf_size);
+}
+
+unsigned long icf_hash(const char* text) {
+    unsigned long h = 14695981039346656037ul; // FNV-1a
+    for (; *text; text++) {
+        h ^= (unsigned char)*text;
+        h *= 1099511628211ul;
+    }
+    return h;
+}
+
+char* icf_canonical(struct decl* d, const char* body, const char* text) {
+    // the code with the function's own labels named by role and the local labels numbered from 0 in order of use
+    char epilogue[256];
+    snprintf(epilogue, sizeof(epilogue), ".%s_epilogue", d->name);
+    int* labels = 0;
+    int nlabels = 0;
+    char* out;
+    size_t size;
+    FILE* canonical = open_memstream(&out, &size);
+
+    while (*text) {
+        if (*text == '"') { // string contents are compared as they are
+            fputc(*text++, canonical);
+            while (*text && *text != '"') {
+                if (*text == '\\' && text[1]) fputc(*text++, canonical);
+                fputc(*text++, canonical);
+            }
+            if (*text) fputc(*text++, canonical);
+            continue;
+        }
+        if (!isalnum((unsigned char)*text) && *text != '_' && *text != '.') {
+            fputc(*text++, canonical);
+            continue;
+        }
+        const char* start = text;
+        while (isalnum((unsigned char)*text) || *text == '_' || *text == '.') text++;
+        size_t length = text - start;
+        if (length > 2 && !strncmp(start, ".L", 2) && strspn(start + 2, "0123456789") == length - 2) {
+            int label = atoi(start + 2);
+            int i;
+            for (i = 0; i < nlabels && labels[i] != label; i++);
+            if (i == nlabels) {
+                labels = realloc(labels, (nlabels + 1) * sizeof(*labels));
+                labels[nlabels++] = label;
+            }
+            fprintf(canonical, ".L@%i", i);
+        } else if ((length == strlen(body) && !strncmp(start, body, length)) || (length == strlen(d->name) && !strncmp(start, d->name, length))) {
+            fputs("@self", canonical);
+        } else if (length >= strlen(body) + 6 && !strncmp(start, ".text.", 6) && start[length - strlen(body) - 1] == '.' && !strncmp(start + length - strlen(body), body, strlen(body))) {
+            fwrite(start, 1, length - strlen(body), canonical); // a section of its own, from -ffunction-sections
+            fputs("@self", canonical);
+        } else if (length == strlen(epilogue) && !strncmp(start, epilogue, length)) {
+            fputs("@epilogue", canonical);
+        } else {
+            fwrite(start, 1, length, canonical);
+        }
+    }
+    fclose(canonical);
+    free(labels);
+    return out;
+}
+
+void icf_end(struct decl* d, const char* body, FILE* stream, FILE* outfile) {
+    // writes the function out, or only an alias for its label if the same code was emitted before
+    fclose(stream);
+    char* canonical = icf_canonical(d, body, icf_text);
+    unsigned long hash = icf_hash(canonical);
+
+    for (int i = 0; i < icf_count; i++) {
+        struct icf_function* f = &icf_functions[i];
+        if (f->hash == hash && !strcmp(f->text, canonical)) {
+            decl_linkage(body, outfile);
+            fprintf(outfile, ".set %s, %s\n", body, f->body);
+            if (icf_report) fprintf(stderr, "icf: %s has the same code as %s\n", d->name, f->body);
+            free(canonical);
+            free(icf_text);
+            icf_text = 0;
+            return;
+        }
+    }
+
+    fwrite(icf_text, 1, icf_size, outfile);
+    free(icf_text);
+    icf_text = 0;
+    if (icf_count == icf_capacity) {
+        icf_capacity = icf_capacity ? icf_capacity * 2 : 16;
+        icf_functions = realloc(icf_functions, icf_capacity * sizeof(*icf_functions));
+    }
+    icf_functions[icf_count].hash = hash;
+    icf_functions[icf_count].text = canonical;
+    icf_functions[icf_count].body = body;
+    icf_count++;
+}
+
+int icf_thunk(struct decl* d, const char* body, FILE* outfile) {
+    // a function that only passes its parameters on, followed by literals, becomes a jump to the function it calls
+    struct stmt* s = d->code;
+    if (!s || s->next || (s->kind != STMT_RETURN && s->kind != STMT_EXPR) || !s->expr || s->expr->kind != EXPR_CALL) return 0;
+    struct expr* call = s->expr;
+    struct callgraph_node* callee = callgraph_lookup(call->left->name);
+    if (!callee || callee->decl->type->kind != TYPE_FUNCTION || !callee->decl->code || callee->decl == d) return 0;
+
+    struct expr* arg = call->right;
+    int count = 0;
+    for (struct param_list* p = d->type->params; p; p = p->next, arg = arg->next, count++) {
+        if (!arg || arg->kind != EXPR_NAME || arg->symbol != p->symbol) return 0; // each one stays in its register
+    }
+    for (struct expr* rest = arg; rest; rest = rest->next, count++) {
+        if (!expr_literal(rest, 0)) return 0;
+    }
+    if (count > ARGS_SYSTEM_V) return 0;
+
+    decl_section_text(body, outfile);
+    decl_linkage(body, outfile);
+    fprintf(outfile, ".p2align 4\n");
+    fprintf(outfile, "%s:\n", body);
+    int i = count;
+    for (struct expr* rest = arg; rest; rest = rest->next) i--; // the literals follow the parameters
+    for (; arg; arg = arg->next, i++) {
+        fprintf(outfile, "\tMOVQ %s, %s\n", expr_operand(arg), arg_name(i));
+    }
+    fprintf(outfile, "\tJMP %s\n", decl_body_name(callee->decl));
+    return 1;
+}
+
+int icf_same_expr(struct expr* a, struct expr* b, int* literal, int* diffs, int* ndiffs) {
+    // true if a and b differ at most in the values of some literals, whose numbers in walk order go into diffs
+    if (!a || !b) return a == b;
+    if (a->kind != b->kind) return 0;
+    switch (a->kind) {
+        case EXPR_INT_LITERAL:
+        case EXPR_BOOL_LITERAL:
+        case EXPR_CHAR_LITERAL:
+            if (a->literal_value != b->literal_value) {
+                if (*ndiffs == ICF_MAX_CONSTANTS) return 0;
+                diffs[(*ndiffs)++] = *literal;
+            }
+            (*literal)++;
+            break;
+        case EXPR_STRING_LITERAL:
+            if (strcmp(a->string_literal, b->string_literal)) return 0;
+            break;
+        case EXPR_NAME:
+            if (strcmp(a->name, b->name) || !a->symbol || !b->symbol || a->symbol->kind != b->symbol->kind) return 0;
+            break;
+        case EXPR_ARRAY_LITERAL: // the elements are not literal nodes a thunk could pass, so they must all match
+            if (!a->elements || !b->elements) return a->elements == b->elements;
+            if (a->elements->count != b->elements->count || a->elements->kind != b->elements->kind || a->elements->mismatched != b->elements->mismatched) return 0;
+            for (int i = 0; i < a->elements->count; i++) {
+                if (a->elements->values[i] != b->elements->values[i]) return 0;
+            }
+            break;
+    }
+    return icf_same_expr(a->left, b->left, literal, diffs, ndiffs) && icf_same_expr(a->right, b->right, literal, diffs, ndiffs) && icf_same_expr(a->next, b->next, literal, diffs, ndiffs);
+}
+
+int icf_same_decl(struct decl* a, struct decl* b, int* literal, int* diffs, int* ndiffs) {
+    for (; a && b; a = a->next, b = b->next) {
+        if (strcmp(a->name, b->name) || !type_compare(a->type, b->type)) return 0;
+        if (!icf_same_expr(a->value, b->value, literal, diffs, ndiffs)) return 0;
+    }
+    return a == b;
+}
+
+int icf_same_stmt(struct stmt* a, struct stmt* b, int* literal, int* diffs, int* ndiffs) {
+    for (; a && b; a = a->next, b = b->next) {
+        if (a->kind != b->kind) return 0;
+        if (!icf_same_decl(a->decl, b->decl, literal, diffs, ndiffs)) return 0;
+        if (!icf_same_expr(a->init_expr, b->init_expr, literal, diffs, ndiffs) || !icf_same_expr(a->expr, b->expr, literal, diffs, ndiffs) || !icf_same_expr(a->next_expr, b->next_expr, literal, diffs, ndiffs)) return 0;
+        if (!icf_same_stmt(a->body, b->body, literal, diffs, ndiffs) || !icf_same_stmt(a->else_body, b->else_body, literal, diffs, ndiffs)) return 0;
+    }
+    return a == b;
+}
+
+int icf_same_function(struct decl* a, struct decl* b, int* diffs, int* ndiffs) {
+    // true if b is a with some literals changed, same signature and parameter names included
+    if (!type_compare(a->type, b->type)) return 0;
+    struct param_list* p = a->type->params;
+    struct param_list* q = b->type->params;
+    for (; p && q; p = p->next, q = q->next) {
+        if (strcmp(p->name, q->name)) return 0;
+    }
+    if (p || q) return 0;
+    int literal = 0;
+    *ndiffs = 0;
+    return icf_same_stmt(a->code, b->code, &literal, diffs, ndiffs);
+}
+
+struct expr* icf_literal_expr(struct expr* e, int* literal, int wanted) {
+    // the literal numbered wanted in the same walk order icf_same_expr uses
+    if (!e) return 0;
+    if (e->kind == EXPR_INT_LITERAL || e->kind == EXPR_BOOL_LITERAL || e->kind == EXPR_CHAR_LITERAL) {
+        if ((*literal)++ == wanted) return e;
+    }
+    struct expr* found = icf_literal_expr(e->left, literal, wanted);
+    if (!found) found = icf_literal_expr(e->right, literal, wanted);
+    if (!found) found = icf_literal_expr(e->next, literal, wanted);
+    return found;
+}
+
+struct expr* icf_literal(struct stmt* s, int* literal, int wanted) {
+    struct expr* found = 0;
+    for (; s && !found; s = s->next) {
+        for (struct decl* d = s->decl; d && !found; d = d->next) found = icf_literal_expr(d->value, literal, wanted);
+        if (!found) found = icf_literal_expr(s->init_expr, literal, wanted);
+        if (!found) found = icf_literal_expr(s->expr, literal, wanted);
+        if (!found) found = icf_literal_expr(s->next_expr, literal, wanted);
+        if (!found) found = icf_literal(s->body, literal, wanted);
+        if (!found) found = icf_literal(s->else_body, literal, wanted);
+    }
+    return found;
+}
+
+struct expr* icf_literal_at(struct decl* d, int wanted) {
+    int literal = 0;
+    return icf_literal(d->code, &literal, wanted);
+}
+
+void icf_merge(struct icf_group* g, int report) {
+    // one copy of the leader takes the differing literals as extra parameters, every member becomes a call of it
+    struct decl* leader = g->leader;
+    char* name = malloc(strlen(leader->name) + 8);
+    sprintf(name, "%s.merged", leader->name);
+
+    struct param_list* params = 0;
+    struct param_list** tail = &params;
+    for (struct param_list* p = leader->type->params; p; p = p->next) {
+        *tail = param_list_create(p->name, type_copy(p->type), 0);
+        tail = &(*tail)->next;
+    }
+    struct stmt* code = stmt_copy(leader->code);
+    for (int k = 0; k < g->nvarying; k++) {
+        int literal = 0;
+        struct expr* e = icf_literal(code, &literal, g->varying[k] - k); // the ones replaced before it no longer count
+        char* param = malloc(16);
+        sprintf(param, "merged.%i", k);
+        type_t kind = e->kind == EXPR_BOOL_LITERAL ? TYPE_BOOLEAN : e->kind == EXPR_CHAR_LITERAL ? TYPE_CHARACTER : TYPE_INTEGER;
+        *tail = param_list_create(param, type_create(kind, 0, 0, 0), 0);
+        tail = &(*tail)->next;
+        e->kind = EXPR_NAME;
+        e->name = param;
+        e->literal_value = 0;
+    }
+    struct decl* merged = decl_create(name, type_create(TYPE_FUNCTION, type_copy(leader->type->subtype), params, leader->type->size), 0, code);
+
+    // the copy gets symbols of its own, resolved in the global scope that is still open
+    decl_resolve(merged, 0);
+    decl_typecheck(merged);
+    merged->next = leader->next;
+    leader->next = merged;
+    struct callgraph_node* node = calloc(1, sizeof(*node));
+    node->decl = merged;
+    node->reachable = 1;
+    hash_table_insert(callgraph_nodes, name, node);
+
+    for (int m = 0; m < g->count; m++) {
+        struct decl* d = g->members[m];
+        struct expr* args = 0;
+        struct expr** link = &args;
+        for (struct param_list* p = d->type->params; p; p = p->next) {
+            *link = expr_create_name(p->name);
+            (*link)->symbol = p->symbol;
+            link = &(*link)->next;
+        }
+        for (int k = 0; k < g->nvarying; k++) {
+            *link = expr_copy(icf_literal_at(d, g->varying[k]));
+            link = &(*link)->next;
+        }
+        struct expr* callee = expr_create_name(name);
+        callee->symbol = merged->symbol;
+        struct expr* call = expr_create(EXPR_CALL, callee, args);
+        d->code = stmt_create(d->type->subtype->kind == TYPE_VOID ? STMT_EXPR : STMT_RETURN, 0, 0, call, 0, 0, 0, 0);
+        d->code->parent_function = d;
+        if (report) fprintf(stderr, "icf: %s shares the body of %s\n", d->name, name);
+    }
+}
+
+struct decl* icf_merge_program(struct decl* program, int report) {
+    // groups functions that differ only in a few literals and gives each group one body
+    struct icf_group* groups = 0;
+    int ngroups = 0;
+    icf_report = report;
+    int diffs[ICF_MAX_CONSTANTS];
+    int ndiffs;
+
+    for (struct decl* d = program; d; d = d->next) {
+        if (d->type->kind != TYPE_FUNCTION || !d->code || stmt_size(d->code) < ICF_MIN_SIZE) continue;
+        if (strchr(d->name, '.')) continue; // copies the compiler made for their literals keep them built in
+        int params = 0;
+        for (struct param_list* p = d->type->params; p; p = p->next) params++;
+        int joined = 0;
+        for (int i = 0; i < ngroups && !joined; i++) {
+            struct icf_group* g = &groups[i];
+            if (!icf_same_function(g->leader, d, diffs, &ndiffs)) continue;
+            int varying[2 * ICF_MAX_CONSTANTS];
+            int n = 0;
+            for (int a = 0, b = 0; a < g->nvarying || b < ndiffs;) { // both are in walk order
+                if (b == ndiffs || (a < g->nvarying && g->varying[a] < diffs[b])) varying[n++] = g->varying[a++];
+                else if (a == g->nvarying || diffs[b] < g->varying[a]) varying[n++] = diffs[b++];
+                else { varying[n++] = diffs[b++]; a++; }
+            }
+            if (n > ICF_MAX_CONSTANTS || params + n > ARGS_SYSTEM_V) continue;
+            memcpy(g->varying, varying, n * sizeof(*varying));
+            g->nvarying = n;
+            g->members = realloc(g->members, (g->count + 1) * sizeof(*g->members));
+            g->members[g->count++] = d;
+            joined = 1;
+        }
+        if (!joined) {
+            groups = realloc(groups, (ngroups + 1) * sizeof(*groups));
+            struct icf_group* g = &groups[ngroups++];
+            g->leader = d;
+            g->members = malloc(sizeof(*g->members));
+            g->members[0] = d;
+            g->count = 1;
+            g->nvarying = 0;
+        }
+    }
+
+    // functions with the very same code are left for icf_end to fold
+    for (int i = 0; i < ngroups; i++) {
+        if (groups[i].count > 1 && groups[i].nvarying) icf_merge(&groups[i], report);
+        free(groups[i].members);
+    }
+    free(groups);
+    return program;
+}
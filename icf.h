@@ -0,0 +1,33 @@
+#ifndef ICF_H
+#define ICF_H
+
+#include <stdio.h>
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+
+/* literals near-identical functions may differ in, each becoming a parameter of the shared body,
+   and the smallest body, in nodes, worth sharing behind thunks */
+#define ICF_MAX_CONSTANTS 3
+#define ICF_MIN_SIZE 12
+
+struct icf_function {
+	unsigned long hash;
+	char* text;          // code with its own name and label numbers taken out
+	const char* body;    // label the first function with this code was emitted under
+};
+
+struct icf_group {
+	struct decl* leader;
+	struct decl** members; // functions shaped like the leader, itself included
+	int count;
+	int varying[ICF_MAX_CONSTANTS]; // literals, numbered in walk order, that differ between members
+	int nvarying;
+};
+
+FILE* icf_begin();
+void icf_end(struct decl* d, const char* body, FILE* stream, FILE* outfile);
+int icf_thunk(struct decl* d, const char* body, FILE* outfile);
+struct decl* icf_merge_program(struct decl* program, int report);
+
+#endif
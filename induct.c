@@ -0,0 +1,361 @@
+#include "induct.h"
+#include "scratch.h"
+#include "symbol.h"
+#include "type.h"
+#include "frame.h"
+#include "range.h"
+#include "label.h"
+#include <stdlib.h>
+#include <string.h>
+
+struct stmt* induct_code = 0; // body of the function being generated
+
+void induct_begin_function(struct decl* d) {
+    induct_code = d->code;
+}
+
+int induct_affine(struct expr* e, struct symbol* counter, long* scale, long* offset) {
+    // true if e is scale * counter + offset for literal scale and offset
+    long a, b, c, d, value;
+    while (e && e->kind == EXPR_GROUP) e = e->right;
+    if (!e) return 0;
+    if (expr_literal(e, &value)) {
+        *scale = 0;
+        *offset = value;
+    } else if (e->kind == EXPR_NAME && e->symbol == counter) {
+        *scale = 1;
+        *offset = 0;
+    } else if (e->kind == EXPR_NEG) {
+        if (!induct_affine(e->right, counter, &a, &b)) return 0;
+        *scale = -a;
+        *offset = -b;
+    } else if (e->kind == EXPR_ADD || e->kind == EXPR_SUB || e->kind == EXPR_MUL) {
+        if (!induct_affine(e->left, counter, &a, &b) || !induct_affine(e->right, counter, &c, &d)) return 0;
+        if (e->kind == EXPR_ADD) {
+            *scale = a + c;
+            *offset = b + d;
+        } else if (e->kind == EXPR_SUB) {
+            *scale = a - c;
+            *offset = b - d;
+        } else if (a == 0 || c == 0) { // only a constant factor keeps it linear
+            *scale = a * d + c * b;
+            *offset = b * d;
+        } else {
+            return 0;
+        }
+    } else {
+        return 0;
+    }
+    return labs(*scale) <= INDUCT_LIMIT && labs(*offset) <= INDUCT_LIMIT;
+}
+
+int induct_invariant(struct expr* e, struct induct_loop* l) {
+    // true if e has the same value throughout the loop and can be computed before it
+    if (!e) return 1;
+    switch (e->kind) {
+        case EXPR_ASSGN:
+        case EXPR_INCR:
+        case EXPR_DECR:
+        case EXPR_CALL:
+        case EXPR_ARRACC:
+        case EXPR_DIV:
+        case EXPR_MOD:
+        case EXPR_EXPO:
+        case EXPR_STRING_LITERAL:
+            return 0;
+        case EXPR_NAME:
+            if (e->symbol == l->counter || e->symbol->type->kind != TYPE_INTEGER) return 0;
+            if (range_stmt_assigns(l->loop->body, e->symbol) || range_assigns(l->loop->expr, e->symbol)) return 0;
+            return 1;
+    }
+    return induct_invariant(e->left, l) && induct_invariant(e->right, l);
+}
+
+int induct_index(struct expr* e, struct induct_loop* l, long* scale, long* offset, struct expr** invariant) {
+    // splits an index into scale * counter + offset + invariant, where the invariant term may be missing
+    long a, b;
+    while (e && e->kind == EXPR_GROUP) e = e->right;
+    *invariant = 0;
+    if (induct_affine(e, l->counter, scale, offset)) return 1;
+    if (e->kind == EXPR_ADD) {
+        if (induct_affine(e->right, l->counter, &a, &b) && induct_index(e->left, l, scale, offset, invariant)) {
+            *scale += a;
+            *offset += b;
+            return 1;
+        }
+        if (induct_affine(e->left, l->counter, &a, &b) && induct_index(e->right, l, scale, offset, invariant)) {
+            *scale += a;
+            *offset += b;
+            return 1;
+        }
+    }
+    if (!induct_invariant(e, l)) return 0;
+    *scale = 0;
+    *offset = 0;
+    *invariant = e;
+    return 1;
+}
+
+int induct_counter(struct expr* step, struct symbol** counter, long* stride) {
+    // recognizes a step that adds a constant to a local integer: i++, i--, i = i + k or i = i - k
+    long value;
+    if (!step || !step->left || step->left->kind != EXPR_NAME) return 0;
+    *counter = step->left->symbol;
+    if (!*counter || (*counter)->kind == SYMBOL_GLOBAL || (*counter)->type->kind != TYPE_INTEGER) return 0;
+
+    if (step->kind == EXPR_INCR || step->kind == EXPR_DECR) {
+        *stride = step->kind == EXPR_INCR ? 1 : -1;
+        return 1;
+    }
+    if (step->kind != EXPR_ASSGN) return 0;
+    struct expr* r = step->right;
+    while (r->kind == EXPR_GROUP) r = r->right;
+    if (r->kind == EXPR_ADD && expr_same_variable(r->left, step->left) && expr_literal(r->right, &value)) {
+        *stride = value;
+    } else if (r->kind == EXPR_ADD && expr_same_variable(r->right, step->left) && expr_literal(r->left, &value)) {
+        *stride = value;
+    } else if (r->kind == EXPR_SUB && expr_same_variable(r->left, step->left) && expr_literal(r->right, &value)) {
+        *stride = -value;
+    } else {
+        return 0;
+    }
+    return *stride != 0 && labs(*stride) <= INDUCT_LIMIT;
+}
+
+int induct_calls(struct stmt* s) {
+    // true if s calls a function, which would take the cursor registers away in the middle of an expression
+    for (; s; s = s->next) {
+        if (s->decl && frame_expr_uses(s->decl->value, EXPR_CALL)) return 1;
+        if (frame_expr_uses(s->init_expr, EXPR_CALL) || frame_expr_uses(s->expr, EXPR_CALL) || frame_expr_uses(s->next_expr, EXPR_CALL)) return 1;
+        if (induct_calls(s->body) || induct_calls(s->else_body)) return 1;
+    }
+    return 0;
+}
+
+int induct_need(struct stmt* s) {
+    // most scratch registers any expression in s needs at once
+    int need = 0;
+    for (; s; s = s->next) {
+        int n[6] = {s->decl ? expr_need(s->decl->value) : 0, expr_need(s->init_expr), expr_need(s->expr), expr_need(s->next_expr), induct_need(s->body), induct_need(s->else_body)};
+        for (int i = 0; i < 6; i++) {
+            if (n[i] > need) need = n[i];
+        }
+        if (s->kind == STMT_PRINT) {
+            for (struct expr* e = s->expr; e; e = e->next) {
+                if (expr_need(e) > need) need = expr_need(e);
+            }
+        }
+    }
+    return need;
+}
+
+int induct_classify(struct induct_loop* l, struct expr* e, long* scale, long* offset) {
+    // cursor candidate that array element e could use, or -1
+    struct symbol* array = e->left->symbol;
+    struct expr* invariant;
+    if (e->cursor || !array || array->type->kind != TYPE_ARRAY) return -1;
+    if (!induct_index(e->right, l, scale, offset, &invariant) || *scale == 0) {
+        if (array->kind != SYMBOL_PARAM || array->reg) return -1;
+        *scale = 0; // an array parameter whose address can at least stay in a register
+        invariant = 0;
+    }
+    for (int i = 0; i < l->count; i++) {
+        struct induct_cursor* c = &l->cursors[i];
+        if (c->array == array && c->scale == *scale && (c->invariant == invariant || (c->invariant && invariant && expr_equal(c->invariant, invariant)))) return i;
+    }
+    if (l->count == INDUCT_CANDIDATES) return -1;
+    struct induct_cursor* c = &l->cursors[l->count];
+    c->array = array;
+    c->scale = *scale;
+    c->invariant = invariant;
+    c->uses = 0;
+    c->reg = -1;
+    return l->count++;
+}
+
+void induct_visit(struct induct_loop* l, struct expr* e, int annotate) {
+    // counts the uses of each candidate, or with annotate points the elements at the cursors that got a register
+    long scale, offset;
+    if (!e) return;
+    if (e->kind == EXPR_ARRACC) {
+        int i = induct_classify(l, e, &scale, &offset);
+        if (i >= 0 && !annotate) l->cursors[i].uses++;
+        if (i >= 0 && annotate && l->cursors[i].reg >= 0) {
+            e->cursor = scratch_name(l->cursors[i].reg);
+            e->indexed = scale == 0;
+            e->displacement = scale == 0 ? 0 : offset * symbol_element_size(l->cursors[i].array);
+            l->accesses = realloc(l->accesses, (l->naccesses + 1) * sizeof(*l->accesses));
+            l->accesses[l->naccesses++] = e;
+        }
+        if (i >= 0 && scale != 0) return; // the index is not evaluated any more
+    }
+    induct_visit(l, e->left, annotate);
+    induct_visit(l, e->right, annotate);
+    induct_visit(l, e->next, annotate);
+}
+
+void induct_visit_stmt(struct induct_loop* l, struct stmt* s, int annotate) {
+    for (; s; s = s->next) {
+        if (s->decl) induct_visit(l, s->decl->value, annotate);
+        induct_visit(l, s->init_expr, annotate);
+        induct_visit(l, s->expr, annotate);
+        induct_visit(l, s->next_expr, annotate);
+        induct_visit_stmt(l, s->body, annotate);
+        induct_visit_stmt(l, s->else_body, annotate);
+    }
+}
+
+int induct_reads(struct expr* e, struct symbol* counter) {
+    // times e reads counter, not counting the elements that no longer evaluate their index
+    if (!e) return 0;
+    if (e->kind == EXPR_NAME) return e->symbol == counter;
+    if (e->kind == EXPR_ARRACC && e->cursor && !e->indexed) return 0;
+    int n = e->kind == EXPR_ASSGN && e->left->kind == EXPR_NAME ? 0 : induct_reads(e->left, counter);
+    return n + induct_reads(e->right, counter) + induct_reads(e->next, counter);
+}
+
+int induct_reads_stmt(struct stmt* s, struct symbol* counter) {
+    int n = 0;
+    for (; s; s = s->next) {
+        if (s->decl) n += induct_reads(s->decl->value, counter);
+        n += induct_reads(s->init_expr, counter) + induct_reads(s->expr, counter) + induct_reads(s->next_expr, counter);
+        n += induct_reads_stmt(s->body, counter) + induct_reads_stmt(s->else_body, counter);
+    }
+    return n;
+}
+
+void induct_replace_test(struct induct_loop* l, struct stmt* s) {
+    // a counter read nowhere but in the test and its own step can go, with the test comparing a cursor instead
+    struct expr* cond = s->expr;
+    struct expr* bound;
+    long end;
+    while (cond && cond->kind == EXPR_GROUP) cond = cond->right;
+    if (!cond || cond->kind < EXPR_GT || cond->kind > EXPR_NEQ) return;
+
+    l->test_kind = cond->kind;
+    if (cond->left->kind == EXPR_NAME && cond->left->symbol == l->counter) {
+        bound = cond->right;
+    } else if (cond->right->kind == EXPR_NAME && cond->right->symbol == l->counter) {
+        bound = cond->left;
+        l->test_kind = expr_mirror(cond->kind);
+    } else {
+        return;
+    }
+    if (!expr_literal(bound, &end) || labs(end) > INDUCT_LIMIT) return;
+    if (!s->init_expr || s->init_expr->kind != EXPR_ASSGN || s->init_expr->left->symbol != l->counter) return; // every entry starts it afresh
+    if (induct_reads_stmt(induct_code, l->counter) != 2) return; // the test and the step
+
+    for (int i = 0; i < l->count; i++) {
+        struct induct_cursor* c = &l->cursors[i];
+        if (c->reg >= 0 && c->scale > 0 && !c->invariant && c->array->kind == SYMBOL_GLOBAL) {
+            l->test = i;
+            l->test_end = c->scale * end * symbol_element_size(c->array); // the cursor moves the same way as the counter, so the comparison holds
+            return;
+        }
+    }
+}
+
+struct induct_loop* induct_begin(struct stmt* s, FILE* outfile) {
+    // keeps the addresses of the array elements loop s indexes with its counter in registers, stepped with the counter
+    struct induct_loop* l;
+    struct symbol* counter;
+    long stride;
+
+    if (!induct_counter(s->next_expr, &counter, &stride)) return 0;
+    if (range_stmt_assigns(s->body, counter) || range_assigns(s->expr, counter)) return 0;
+    if (induct_calls(s->body) || frame_expr_uses(s->expr, EXPR_CALL)) return 0;
+
+    // whatever registers the loop does not need at its busiest point can hold cursors
+    int need = induct_need(s->body);
+    if (expr_need(s->expr) > need) need = expr_need(s->expr);
+    if (expr_need(s->next_expr) > need) need = expr_need(s->next_expr);
+    int room = scratch_available() - need - 1;
+    if (room > INDUCT_MAX_CURSORS) room = INDUCT_MAX_CURSORS;
+    if (room <= 0) return 0;
+
+    l = calloc(1, sizeof(*l));
+    l->loop = s;
+    l->counter = counter;
+    l->step = stride;
+    l->test = -1;
+    induct_visit(l, s->expr, 0);
+    induct_visit_stmt(l, s->body, 0);
+
+    // the most used candidates get the registers
+    for (; room > 0; room--) {
+        struct induct_cursor* best = 0;
+        for (int i = 0; i < l->count; i++) {
+            if (l->cursors[i].reg < 0 && l->cursors[i].uses && (!best || l->cursors[i].uses > best->uses)) best = &l->cursors[i];
+        }
+        if (!best) break;
+        best->reg = scratch_alloc();
+    }
+    induct_visit(l, s->expr, 1);
+    induct_visit_stmt(l, s->body, 1);
+    if (!l->naccesses) {
+        induct_end(l);
+        return 0;
+    }
+
+    for (int i = 0; i < l->count; i++) {
+        struct induct_cursor* c = &l->cursors[i];
+        if (c->reg < 0) continue;
+        const char* reg = scratch_name(c->reg);
+        if (c->scale == 0) {
+            fprintf(outfile, "\tMOVQ %s, %s\n", symbol_codegen(c->array), reg);
+            continue;
+        }
+        fprintf(outfile, "\tMOVQ %s, %s\n", symbol_codegen(counter), reg);
+        if (c->scale != 1) fprintf(outfile, "\tIMULQ $%li, %s, %s\n", c->scale, reg, reg);
+        if (c->invariant) {
+            expr_codegen(c->invariant, outfile);
+            fprintf(outfile, "\tADDQ %s, %s\n", scratch_name(c->invariant->reg), reg);
+            scratch_free(c->invariant->reg);
+        }
+        if (c->array->kind == SYMBOL_GLOBAL) {
+            fprintf(outfile, "\tLEAQ %s(, %s, %i), %s\n", c->array->name, reg, symbol_element_size(c->array), reg);
+        } else {
+            int base = scratch_alloc();
+            fprintf(outfile, "\tMOVQ %s, %s\n", symbol_codegen(c->array), scratch_name(base));
+            fprintf(outfile, "\tLEAQ (%s, %s, %i), %s\n", scratch_name(base), reg, symbol_element_size(c->array), reg);
+            scratch_free(base);
+        }
+    }
+    induct_replace_test(l, s);
+    return l;
+}
+
+void induct_branch(struct induct_loop* l, struct expr* cond, int label, int when, FILE* outfile) {
+    // the loop test, on the cursor that replaced the counter if there is one
+    if (!l || l->test < 0) {
+        expr_codegen_branch(cond, label, when, outfile);
+        return;
+    }
+    struct induct_cursor* c = &l->cursors[l->test];
+    fprintf(outfile, "\tCMPQ $%s%+li, %s\n", c->array->name, l->test_end, scratch_name(c->reg));
+    fprintf(outfile, "\t%s %s\n", expr_jump_name(l->test_kind, when), label_name(label));
+}
+
+void induct_step(struct induct_loop* l, struct expr* step, FILE* outfile) {
+    if (step && (!l || l->test < 0)) expr_codegen_effect(step, outfile);
+    if (!l) return;
+    for (int i = 0; i < l->count; i++) {
+        struct induct_cursor* c = &l->cursors[i];
+        if (c->reg >= 0 && c->scale) fprintf(outfile, "\tADDQ $%li, %s\n", c->scale * l->step * symbol_element_size(c->array), scratch_name(c->reg));
+    }
+}
+
+void induct_end(struct induct_loop* l) {
+    // gives the registers back and lets the elements compute their address again
+    if (!l) return;
+    for (int i = 0; i < l->naccesses; i++) {
+        l->accesses[i]->cursor = 0;
+        l->accesses[i]->indexed = 0;
+        l->accesses[i]->displacement = 0;
+    }
+    for (int i = 0; i < l->count; i++) {
+        if (l->cursors[i].reg >= 0) scratch_free(l->cursors[i].reg);
+    }
+    free(l->accesses);
+    free(l);
+}
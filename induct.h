@@ -0,0 +1,47 @@
+#ifndef INDUCT_H
+#define INDUCT_H
+
+#include <stdio.h>
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+
+/* most registers one loop keeps array addresses in, and the most arrays it looks at for them */
+#define INDUCT_MAX_CURSORS 4
+#define INDUCT_CANDIDATES 16
+/* largest literal factor or offset an index may have and still be followed */
+#define INDUCT_LIMIT (1 << 20)
+
+struct induct_cursor {
+	struct symbol* array;
+	long scale;  // elements the cursor moves per unit of the counter, 0 for an array address hoisted out of the loop
+	struct expr* invariant; // part of the index the loop does not change, added once before it starts
+	int uses;
+	int reg;     // scratch register it lives in, -1 if the loop cannot spare one
+};
+
+struct induct_loop {
+	struct stmt* loop;
+	struct symbol* counter;
+	long step;                     // added to the counter each iteration
+	struct induct_cursor cursors[INDUCT_CANDIDATES];
+	int count;
+	struct expr** accesses;        // array elements now addressed through a cursor
+	int naccesses;
+	int test;                      // cursor the loop test compares instead of the counter, -1 if the counter stays
+	expr_t test_kind;
+	long test_end;                 // byte offset from the array that the test compares the cursor with
+};
+
+void induct_begin_function(struct decl* d);
+struct induct_loop* induct_begin(struct stmt* s, FILE* outfile);
+void induct_branch(struct induct_loop* l, struct expr* cond, int label, int when, FILE* outfile);
+void induct_step(struct induct_loop* l, struct expr* step, FILE* outfile);
+void induct_end(struct induct_loop* l);
+int induct_affine(struct expr* e, struct symbol* counter, long* scale, long* offset);
+int induct_invariant(struct expr* e, struct induct_loop* l);
+int induct_index(struct expr* e, struct induct_loop* l, long* scale, long* offset, struct expr** invariant);
+int induct_calls(struct stmt* s);
+int induct_need(struct stmt* s);
+
+#endif
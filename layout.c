@@ -0,0 +1,53 @@
+#include "layout.h"
+#include "decl.h"
+#include <stdlib.h>
+
+FILE* layout_cold = 0;  // out of line blocks of the function being generated
+char* layout_cold_text = 0;
+size_t layout_cold_size = 0;
+int layout_loop_depth = 0;
+
+void layout_begin_function() {
+    layout_cold = open_memstream(&layout_cold_text, &layout_cold_size);
+    layout_loop_depth = 0;
+}
+
+void layout_end_function(const char* name, FILE* outfile) {
+    // cold blocks go after the function in their own section, so hot code packs densely
+    fclose(layout_cold);
+    layout_cold = 0;
+    if (layout_cold_size) {
+        if (decl_function_sections) fprintf(outfile, ".pushsection .text.unlikely.%s,\"ax\",@progbits\n", name); // dropped along with the function
+        else fprintf(outfile, ".pushsection .text.unlikely,\"ax\",@progbits\n");
+        fwrite(layout_cold_text, 1, layout_cold_size, outfile);
+        fprintf(outfile, ".popsection\n");
+    }
+    free(layout_cold_text);
+    layout_cold_text = 0;
+    layout_cold_size = 0;
+}
+
+int layout_stmt_returns(struct stmt* s) {
+    // true if the statement list leaves the function on its own level or in a nested block
+    for (; s; s = s->next) {
+        if (s->kind == STMT_RETURN) return 1;
+        if (s->kind == STMT_BLOCK && layout_stmt_returns(s->body)) return 1;
+    }
+    return 0;
+}
+
+int layout_stmt_prints(struct stmt* s) {
+    for (; s; s = s->next) {
+        if (s->kind == STMT_PRINT) return 1;
+        if (s->kind == STMT_BLOCK && layout_stmt_prints(s->body)) return 1;
+    }
+    return 0;
+}
+
+int layout_is_cold(struct stmt* arm, FILE* outfile) {
+    /* static guess: an arm that returns from inside a loop leaves the loop, and one that
+    prints and returns is reporting an error. Either runs at most once, so keep it out of line */
+    if (!arm || !layout_cold || outfile == layout_cold) return 0;
+    if (!layout_stmt_returns(arm)) return 0;
+    return layout_loop_depth > 0 || layout_stmt_prints(arm);
+}
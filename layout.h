@@ -0,0 +1,16 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <stdio.h>
+#include "stmt.h"
+
+extern FILE* layout_cold;
+extern int layout_loop_depth;
+
+void layout_begin_function();
+void layout_end_function(const char* name, FILE* outfile);
+int layout_is_cold(struct stmt* arm, FILE* outfile);
+int layout_stmt_returns(struct stmt* s);
+int layout_stmt_prints(struct stmt* s);
+
+#endif
@@ -15,6 +15,21 @@ print_integer(x);
 print_boolean(b);
 print_string(s);
 
+Consecutive items of one print statement are lowered by the compiler into
+a single call to print_items.  Constant items are folded into the literal
+text of the descriptor, and every other item is replaced by one of the
+PRINT_ITEM_* codes from library.h, taking its value from the next slot of
+the argument block.  An item that may print or assign, such as a function
+call, starts a new call so that it runs after the items before it are
+printed.  So the following bminor code:
+
+print "x = ", x, "\n";
+
+Is effectively this C code:
+
+long args[] = { x };
+print_items("x = \001\n", args);
+
 And the following bminor code:
 
 x = a ^ b;
@@ -22,30 +37,154 @@ x = a ^ b;
 Is effectively this C code:
 
 x = integer_power(a,b);
+
+All output goes through a buffer owned by this library instead of stdio.
+Integers are converted by hand, strings are copied with memcpy, and the
+buffer is handed to the kernel with a single write(2) whenever it fills
+up, at exit, and (in line buffered mode) at the end of every line.
+The mode defaults to line buffering when stdout is a terminal and full
+buffering otherwise; set BMINOR_OUTPUT=line or BMINOR_OUTPUT=full in the
+environment, or call output_set_mode from C, to choose it explicitly.
+C code that mixes its own stdio output with bminor prints should call
+output_flush before writing to keep the two in order.
+
+With -fmemoize, calls of pure recursive functions go through memo_lookup
+and memo_store.  Each function has a fixed-size, open-addressed table of
+BMINOR_MEMO_CAPACITY slots (rounded up to a power of two, at most
+MEMO_MAX_CAPACITY), created on its first call.  A key is looked for in
+MEMO_PROBES slots from its hash, and when all of them are taken the first
+is overwritten.  Hits and misses of every table are printed to stderr at
+exit unless BMINOR_MEMO_STATS=off.
 */
+#define _POSIX_C_SOURCE 200809L
 #include "library.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define OUTPUT_BUFFER_SIZE 65536
+
+static char output_buffer[OUTPUT_BUFFER_SIZE];
+static size_t output_used = 0;
+static int output_mode = -1; // not yet chosen
+
+void output_flush( void )
+{
+	size_t done = 0;
+
+	fflush(stdout); // anything C code left in stdio goes out first
+	while(done<output_used) {
+		ssize_t n = write(STDOUT_FILENO,output_buffer+done,output_used-done);
+		if(n<0) {
+			if(errno==EINTR) continue;
+			break;
+		}
+		done += n;
+	}
+	output_used = 0;
+}
+
+static void output_init( void )
+{
+	const char *mode = getenv("BMINOR_OUTPUT");
+
+	if(mode && !strcmp(mode,"line")) {
+		output_mode = OUTPUT_LINE_BUFFERED;
+	} else if(mode && !strcmp(mode,"full")) {
+		output_mode = OUTPUT_FULLY_BUFFERED;
+	} else {
+		output_mode = isatty(STDOUT_FILENO) ? OUTPUT_LINE_BUFFERED : OUTPUT_FULLY_BUFFERED;
+	}
+	atexit(output_flush);
+}
+
+void output_set_mode( int mode )
+{
+	if(output_mode<0) output_init();
+	output_flush();
+	output_mode = mode;
+}
+
+static void output_write( const char *data, size_t n )
+{
+	if(output_mode<0) output_init();
+
+	if(n>OUTPUT_BUFFER_SIZE-output_used) {
+		output_flush();
+		if(n>OUTPUT_BUFFER_SIZE) { // too big to be worth copying
+			while(n>0) {
+				ssize_t w = write(STDOUT_FILENO,data,n);
+				if(w<0) {
+					if(errno==EINTR) continue;
+					return;
+				}
+				data += w;
+				n -= w;
+			}
+			return;
+		}
+	}
+	memcpy(output_buffer+output_used,data,n);
+	output_used += n;
+
+	if(output_mode==OUTPUT_LINE_BUFFERED && memchr(data,'\n',n)) {
+		output_flush();
+	}
+}
 
 void print_integer( long x )
 {
-	printf("%ld",x);
+	char digits[24];
+	char *p = digits + sizeof(digits);
+	unsigned long u = x<0 ? 0UL-(unsigned long)x : (unsigned long)x;
+
+	do {
+		*--p = '0' + u%10;
+		u /= 10;
+	} while(u);
+	if(x<0) *--p = '-';
+
+	output_write(p,digits+sizeof(digits)-p);
 }
 
 void print_string( const char *s )
 {
-	printf("%s",s);
+	output_write(s,strlen(s));
 }
 
 void print_boolean( int b )
 {
-	printf("%s",b?"true":"false");
+	if(b) {
+		output_write("true",4);
+	} else {
+		output_write("false",5);
+	}
 }
 
 void print_character( char c )
 {
-	printf("%c",c);
+	output_write(&c,1);
+}
+
+void print_items( const char *desc, const long *args )
+{
+	while(*desc) {
+		size_t n = strcspn(desc,"\001\002\003\004");
+		if(n) {
+			output_write(desc,n);
+			desc += n;
+			continue;
+		}
+		switch(*desc++) {
+			case PRINT_ITEM_INTEGER:   print_integer(*args++); break;
+			case PRINT_ITEM_BOOLEAN:   print_boolean(*args++); break;
+			case PRINT_ITEM_CHARACTER: print_character(*args++); break;
+			case PRINT_ITEM_STRING:    print_string((const char*)*args++); break;
+		}
+	}
 }
 
 long integer_power( long x, long y )
@@ -58,6 +197,109 @@ long integer_power( long x, long y )
 	return result;
 }
 
+struct memo_table {
+	const char *name;
+	size_t capacity;         // slots, a power of two
+	int count;               // arguments in a key
+	long *slots;             // each one a used flag, the key and the value
+	long hits;
+	long misses;
+	long entries;
+	long evictions;
+	struct memo_table *next;
+};
+
+static struct memo_table *memo_tables = 0;
+
+static void memo_report( void )
+{
+	const char *stats = getenv("BMINOR_MEMO_STATS");
+	if(stats && !strcmp(stats,"off")) return;
+	for(struct memo_table *t=memo_tables;t;t=t->next) {
+		fprintf(stderr,"memo: %s: %ld hits, %ld misses, %ld of %zu slots used, %ld evicted\n",t->name,t->hits,t->misses,t->entries,t->capacity,t->evictions);
+	}
+}
+
+static struct memo_table * memo_create( const char *name, int count )
+{
+	const char *env = getenv("BMINOR_MEMO_CAPACITY");
+	char *end;
+	long wanted = env ? strtol(env,&end,10) : MEMO_DEFAULT_CAPACITY;
+	if(env && (end==env || *end || wanted<=0)) wanted = MEMO_DEFAULT_CAPACITY;
+	if(wanted>MEMO_MAX_CAPACITY) wanted = MEMO_MAX_CAPACITY;
+	size_t capacity = MEMO_PROBES;
+	while(capacity<(size_t)wanted) capacity *= 2;
+
+	struct memo_table *t = calloc(1,sizeof(*t));
+	long *slots = calloc(capacity*(count+2),sizeof(long));
+	if(!t || !slots) {
+		fprintf(stderr,"memo: cannot allocate %zu slots for %s\n",capacity,name);
+		exit(1);
+	}
+	t->slots = slots;
+	t->name = name;
+	t->capacity = capacity;
+	t->count = count;
+	if(!memo_tables) atexit(memo_report);
+	t->next = memo_tables;
+	memo_tables = t;
+	return t;
+}
+
+static size_t memo_hash( const long *key, int count )
+{
+	uint64_t h = 0x9e3779b97f4a7c15ull;
+	for(int i=0;i<count;i++) {
+		h ^= (uint64_t)key[i];
+		h *= 0xff51afd7ed558ccdull;
+		h ^= h>>33;
+	}
+	return h;
+}
+
+int memo_lookup( void **table, const char *name, const long *key, int count, long *result )
+{
+	if(!*table) *table = memo_create(name,count);
+	struct memo_table *t = *table;
+	size_t home = memo_hash(key,count);
+
+	for(int probe=0;probe<MEMO_PROBES;probe++) {
+		long *slot = t->slots + ((home+probe)&(t->capacity-1))*(count+2);
+		if(!slot[0]) break;
+		if(!memcmp(slot+1,key,count*sizeof(long))) {
+			*result = slot[count+1];
+			t->hits++;
+			return 1;
+		}
+	}
+	t->misses++;
+	return 0;
+}
+
+void memo_store( void **table, const long *key, int count, long value )
+{
+	struct memo_table *t = *table;
+	size_t home = memo_hash(key,count);
+	long *slot = 0;
+
+	for(int probe=0;probe<MEMO_PROBES;probe++) {
+		long *s = t->slots + ((home+probe)&(t->capacity-1))*(count+2);
+		if(!s[0] || !memcmp(s+1,key,count*sizeof(long))) {
+			slot = s;
+			break;
+		}
+	}
+	if(!slot) { // every slot it may use is taken, the newest result replaces the first
+		slot = t->slots + (home&(t->capacity-1))*(count+2);
+		t->evictions++;
+	} else if(!slot[0]) {
+		t->entries++;
+	}
+	slot[0] = 1;
+	memcpy(slot+1,key,count*sizeof(long));
+	slot[count+1] = value;
+}
+
 int compare_strings(const char* s1, const char* s2) {
 	return strcmp(s1, s2);
 }
\ No newline at end of file
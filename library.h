@@ -1,10 +1,32 @@
 #ifndef LIBRARY_H
 #define LIBRARY_H
 
+/* item codes used in the type descriptor handed to print_items */
+#define PRINT_ITEM_INTEGER   '\001'
+#define PRINT_ITEM_BOOLEAN   '\002'
+#define PRINT_ITEM_CHARACTER '\003'
+#define PRINT_ITEM_STRING    '\004'
+
+/* buffering modes accepted by output_set_mode */
+#define OUTPUT_LINE_BUFFERED  0
+#define OUTPUT_FULLY_BUFFERED 1
+
+/* memo tables used by -fmemoize: slots when BMINOR_MEMO_CAPACITY does not say or is not a positive number, the most it may ask for, and slots searched for a key */
+#define MEMO_DEFAULT_CAPACITY 65536
+#define MEMO_MAX_CAPACITY (1L << 24)
+#define MEMO_PROBES 8
+
 void print_integer( long x );
 void print_string( const char *s );
 void print_boolean( int b );
 void print_character( char c );
+void print_items( const char *desc, const long *args );
 long integer_power( long x, long y );
 
+int memo_lookup( void **table, const char *name, const long *key, int count, long *result );
+void memo_store( void **table, const long *key, int count, long value );
+
+void output_flush( void );
+void output_set_mode( int mode );
+
 #endif
\ No newline at end of file
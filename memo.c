@@ -0,0 +1,88 @@
+#include "memo.h"
+#include "eval.h"
+#include "scratch.h"
+#include "label.h"
+#include <string.h>
+
+int memo_enabled = 0; // set by -fmemoize
+
+int memo_calls_self(struct expr* e, const char* name) {
+    if (!e) return 0;
+    if (e->kind == EXPR_CALL && e->left && !strcmp(e->left->name, name)) return 1;
+    return memo_calls_self(e->left, name) || memo_calls_self(e->right, name) || memo_calls_self(e->next, name);
+}
+
+int memo_stmt_calls_self(struct stmt* s, const char* name) {
+    for (; s; s = s->next) {
+        if (s->decl && memo_calls_self(s->decl->value, name)) return 1;
+        if (memo_calls_self(s->init_expr, name) || memo_calls_self(s->expr, name) || memo_calls_self(s->next_expr, name)) return 1;
+        if (memo_stmt_calls_self(s->body, name) || memo_stmt_calls_self(s->else_body, name)) return 1;
+    }
+    return 0;
+}
+
+int memo_function(struct decl* d) {
+    // true if calls of d go through a cache: a pure recursive function of a few scalars, whose result depends on nothing else
+    if (!memo_enabled || d->type->kind != TYPE_FUNCTION || !d->code || !eval_is_pure(d->name)) return 0;
+    int count = 0;
+    for (struct param_list* p = d->type->params; p; p = p->next) count++;
+    return count <= MEMO_MAX_ARGS && memo_stmt_calls_self(d->code, d->name);
+}
+
+char* memo_codegen(struct decl* d, FILE* outfile) {
+    // the entry callers reach: looks the arguments up and only runs the body for ones it has not seen
+    // returns the label of the body the cache calls on a miss, the caller emits the body under it and frees it
+    const char* body = decl_body_name(d);
+    char* compute = malloc(strlen(d->name) + 10);
+    sprintf(compute, "%s.compute", d->name);
+    int count = 0;
+    for (struct param_list* p = d->type->params; p; p = p->next) count++;
+    int frame = (count * 8 + 8 + 15) / 16 * 16; // the arguments as a key, then the result
+    int key = -count * 8;
+    int result = key - 8;
+    int miss = label_create();
+
+    decl_section_data(body, 0, outfile);
+    fprintf(outfile, "%s.memo: .quad 0\n", d->name); // the table, created by the first lookup
+    fprintf(outfile, "%s.memo_name: .string \"%s\"\n", d->name, d->name);
+    decl_section_text(body, outfile);
+    decl_linkage(body, outfile);
+    fprintf(outfile, ".p2align 4\n");
+    fprintf(outfile, "%s:\n", body);
+    fprintf(outfile, "\tPUSHQ %%rbp\n");
+    fprintf(outfile, "\tMOVQ %%rsp, %%rbp\n");
+    fprintf(outfile, "\tSUBQ $%i, %%rsp\n", frame);
+    for (int i = 0; i < count; i++) {
+        fprintf(outfile, "\tMOVQ %s, %i(%%rbp)\n", arg_name(i), key + i * 8);
+    }
+
+    fprintf(outfile, "\tLEAQ %s.memo, %%rdi\n", d->name);
+    fprintf(outfile, "\tLEAQ %s.memo_name, %%rsi\n", d->name);
+    fprintf(outfile, "\tLEAQ %i(%%rbp), %%rdx\n", key);
+    fprintf(outfile, "\tMOVQ $%i, %%rcx\n", count);
+    fprintf(outfile, "\tLEAQ %i(%%rbp), %%r8\n", result);
+    fprintf(outfile, "\tCALL memo_lookup\n");
+    fprintf(outfile, "\tTESTL %%eax, %%eax\n");
+    fprintf(outfile, "\tJZ %s\n", label_name(miss));
+    fprintf(outfile, "\tMOVQ %i(%%rbp), %%rax\n", result);
+    fprintf(outfile, "\tMOVQ %%rbp, %%rsp\n");
+    fprintf(outfile, "\tPOPQ %%rbp\n");
+    fprintf(outfile, "\tRET\n");
+
+    fprintf(outfile, "%s:\n", label_name(miss));
+    for (int i = 0; i < count; i++) {
+        fprintf(outfile, "\tMOVQ %i(%%rbp), %s\n", key + i * 8, arg_name(i));
+    }
+    fprintf(outfile, "\tCALL %s\n", compute);
+    fprintf(outfile, "\tMOVQ %%rax, %i(%%rbp)\n", result);
+    fprintf(outfile, "\tLEAQ %s.memo, %%rdi\n", d->name);
+    fprintf(outfile, "\tLEAQ %i(%%rbp), %%rsi\n", key);
+    fprintf(outfile, "\tMOVQ $%i, %%rdx\n", count);
+    fprintf(outfile, "\tMOVQ %%rax, %%rcx\n");
+    fprintf(outfile, "\tCALL memo_store\n");
+    fprintf(outfile, "\tMOVQ %i(%%rbp), %%rax\n", result);
+    fprintf(outfile, "\tMOVQ %%rbp, %%rsp\n");
+    fprintf(outfile, "\tPOPQ %%rbp\n");
+    fprintf(outfile, "\tRET\n\n");
+    return compute;
+}
@@ -0,0 +1,19 @@
+#ifndef MEMO_H
+#define MEMO_H
+
+#include <stdio.h>
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+
+/* most parameters a memoized function may have, all of them passed in registers */
+#define MEMO_MAX_ARGS 6
+
+extern int memo_enabled;
+
+int memo_calls_self(struct expr* e, const char* name);
+int memo_stmt_calls_self(struct stmt* s, const char* name);
+int memo_function(struct decl* d);
+char* memo_codegen(struct decl* d, FILE* outfile);
+
+#endif
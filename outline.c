@@ -0,0 +1,199 @@
+#include "outline.h"
+#include <stdlib.h>
+#include <string.h>
+
+int outline_enabled = 0; // set by -Os
+
+char* outline_text = 0;
+size_t outline_size_text = 0;
+struct outline_line* outline_lines = 0;
+int outline_length = 0; // instructions in the windows being compared
+
+FILE* outline_begin() {
+    // the scheduled code is collected in memory, outline_end looks for repeats across all of it
+    return open_memstream(&outline_text, &outline_size_text);
+}
+
+int outline_eligible(const char* line) {
+    // an instruction moved into a subroutine sees the stack one return address lower, so nothing that touches the stack or jumps qualifies
+    if (line[0] != '\t' || line[1] == '.' || strstr(line, "%rsp")) return 0;
+    const char* mnemonic = line + 1;
+    if (*mnemonic == 'J' || !strncmp(mnemonic, "CALL", 4) || !strncmp(mnemonic, "RET", 3)) return 0;
+    if (!strncmp(mnemonic, "PUSH", 4) || !strncmp(mnemonic, "POP", 3) || !strncmp(mnemonic, "LEAVE", 5)) return 0;
+    return 1;
+}
+
+int outline_operand_size(const char* operand, size_t length) {
+    // bytes an operand adds to the REX prefix, opcode and ModRM byte: immediates, displacements and an index byte
+    char text[64];
+    if (length >= sizeof(text)) return 4;
+    memcpy(text, operand, length);
+    text[length] = 0;
+    if (text[0] == '%') return 0;
+
+    char* end;
+    if (text[0] == '$') {
+        long value = strtol(text + 1, &end, 10);
+        if (end == text + 1 || *end) return 4; // the address of a label
+        return value >= -128 && value <= 127 ? 1 : value == (int)value ? 4 : 8;
+    }
+
+    char* paren = strchr(text, '(');
+    int size = paren && strchr(paren, ',') ? 1 : 0; // an index register takes a SIB byte
+    if (paren == text) return size;
+    long displacement = strtol(text, &end, 10);
+    if (end == text || end != paren) return size + 4; // a label, possibly with an offset
+    return size + (displacement == 0 ? 0 : displacement >= -128 && displacement <= 127 ? 1 : 4);
+}
+
+int outline_size(const char* line) {
+    // estimated length of the encoding, kept low so a CALL is only used where it is surely shorter than what it replaces
+    const char* p = line + 1;
+    const char* mnemonic_end = p + strcspn(p, " \n");
+    int size = mnemonic_end[-1] == 'Q' ? 3 : 2; // opcode and ModRM byte, and a REX prefix for 64 bit operands
+    int operands = 0;
+    int registers = 1; // no immediates or memory operands
+    p = mnemonic_end;
+    while (*p == ' ') p++;
+    while (*p && *p != '\n') {
+        const char* start = p;
+        int depth = 0;
+        while (*p && *p != '\n' && (depth || *p != ',')) {
+            if (*p == '(') depth++;
+            if (*p == ')') depth--;
+            p++;
+        }
+        if (*start != '%') registers = 0;
+        size += outline_operand_size(start, p - start);
+        operands++;
+        if (*p == ',') p++;
+        while (*p == ' ') p++;
+    }
+    if (!operands) return 1; // CQTO and the like take one or two bytes
+    if (registers) return 2;  // two or three
+    return size;
+}
+
+int outline_compare(const void* a, const void* b) {
+    // orders windows so identical sequences are next to each other, each group by position
+    const struct outline_window* x = a;
+    const struct outline_window* y = b;
+    if (x->hash != y->hash) return x->hash < y->hash ? -1 : 1;
+    for (int i = 0; i < outline_length; i++) {
+        int c = strcmp(outline_lines[x->start + i].text, outline_lines[y->start + i].text);
+        if (c) return c;
+    }
+    return x->start - y->start;
+}
+
+int outline_same(int a, int b) {
+    for (int i = 0; i < outline_length; i++) {
+        if (strcmp(outline_lines[a + i].text, outline_lines[b + i].text)) return 0;
+    }
+    return 1;
+}
+
+int outline_free(int start) {
+    // true if none of the window's instructions went into a subroutine yet
+    for (int i = 0; i < outline_length; i++) {
+        if (outline_lines[start + i].taken) return 0;
+    }
+    return 1;
+}
+
+void outline_end(FILE* stream, FILE* outfile, int report) {
+    // replaces sequences that repeat often enough with calls of one copy, longest sequences first
+    fclose(stream);
+    int count = 0;
+    int capacity = 0;
+    char* line = outline_text;
+    while (line && *line) {
+        char* end = strchr(line, '\n');
+        size_t length = end ? (size_t)(end - line + 1) : strlen(line);
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 1024;
+            outline_lines = realloc(outline_lines, capacity * sizeof(*outline_lines));
+        }
+        struct outline_line* l = &outline_lines[count++];
+        l->text = malloc(length + 1);
+        memcpy(l->text, line, length);
+        l->text[length] = 0;
+        l->hash = 5381;
+        for (const char* c = l->text; *c; c++) l->hash = l->hash * 33 + (unsigned char)*c;
+        l->eligible = outline_eligible(l->text);
+        l->size = l->eligible ? outline_size(l->text) : 0;
+        l->taken = 0;
+        l->removed = 0;
+        l->call = -1;
+        line += length;
+    }
+
+    struct outline_window* windows = malloc((count + 1) * sizeof(*windows));
+    int* chosen = malloc((count + 1) * sizeof(*chosen));
+    struct outline_subroutine* subroutines = 0;
+    int nsubroutines = 0;
+    for (outline_length = OUTLINE_MAX_LENGTH; outline_length >= OUTLINE_MIN_LENGTH; outline_length--) {
+        int nwindows = 0;
+        int run = 0; // eligible lines not yet taken that end at i
+        for (int i = 0; i < count; i++) {
+            run = outline_lines[i].eligible && !outline_lines[i].taken ? run + 1 : 0;
+            if (run < outline_length) continue;
+            int start = i - outline_length + 1;
+            unsigned long hash = 0;
+            for (int j = start; j <= i; j++) hash = hash * 1000003 + outline_lines[j].hash;
+            windows[nwindows].start = start;
+            windows[nwindows].hash = hash;
+            nwindows++;
+        }
+        qsort(windows, nwindows, sizeof(*windows), outline_compare);
+
+        for (int a = 0, b; a < nwindows; a = b) {
+            for (b = a + 1; b < nwindows && windows[b].hash == windows[a].hash && outline_same(windows[a].start, windows[b].start); b++);
+            if (b - a < 2) continue;
+
+            // copies may overlap each other or a sequence outlined earlier in this pass
+            int n = 0;
+            for (int w = a; w < b; w++) {
+                int start = windows[w].start;
+                if ((!n || start >= chosen[n - 1] + outline_length) && outline_free(start)) chosen[n++] = start;
+            }
+            int size = 0;
+            for (int i = 0; i < outline_length; i++) size += outline_lines[windows[a].start + i].size;
+            int saved = n * size - (n * OUTLINE_CALL_SIZE + size + OUTLINE_RET_SIZE);
+            if (n < 2 || saved < OUTLINE_MIN_SAVING) continue;
+
+            for (int c = 0; c < n; c++) {
+                for (int i = 0; i < outline_length; i++) {
+                    outline_lines[chosen[c] + i].taken = 1;
+                    outline_lines[chosen[c] + i].removed = 1;
+                }
+                outline_lines[chosen[c]].call = nsubroutines;
+            }
+            subroutines = realloc(subroutines, (nsubroutines + 1) * sizeof(*subroutines));
+            subroutines[nsubroutines].start = chosen[0];
+            subroutines[nsubroutines].length = outline_length;
+            if (report) fprintf(stderr, "outline: %d copies of a %d instruction sequence share .outlined_%d, about %d bytes saved\n", n, outline_length, nsubroutines, saved);
+            nsubroutines++;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (outline_lines[i].call >= 0) fprintf(outfile, "\tCALL .outlined_%d\n", outline_lines[i].call);
+        else if (!outline_lines[i].removed) fputs(outline_lines[i].text, outfile);
+    }
+    for (int s = 0; s < nsubroutines; s++) { // each keeps the text of the copy it was made from
+        fprintf(outfile, "\n.text\n.outlined_%d:\n", s);
+        for (int i = 0; i < subroutines[s].length; i++) fputs(outline_lines[subroutines[s].start + i].text, outfile);
+        fprintf(outfile, "\tRET\n");
+    }
+
+    for (int i = 0; i < count; i++) free(outline_lines[i].text);
+    free(outline_lines);
+    outline_lines = 0;
+    free(windows);
+    free(chosen);
+    free(subroutines);
+    free(outline_text);
+    outline_text = 0;
+    outline_size_text = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef OUTLINE_H
+#define OUTLINE_H
+
+#include <stdio.h>
+
+/* shortest and longest instruction sequences looked for, longest first */
+#define OUTLINE_MIN_LENGTH 2
+#define OUTLINE_MAX_LENGTH 16
+/* bytes a CALL to a subroutine and its RET take */
+#define OUTLINE_CALL_SIZE 5
+#define OUTLINE_RET_SIZE 1
+/* bytes a subroutine has to save by the estimate before it is made, since what it saves inside
+   a function can vanish into the padding that keeps the next one 16 byte aligned */
+#define OUTLINE_MIN_SAVING 16
+
+extern int outline_enabled;
+
+struct outline_line {
+	char *text;
+	unsigned long hash;
+	int eligible;   // an instruction that does the same behind a CALL: no control flow, no stack
+	int size;       // estimated bytes of its encoding
+	int taken;      // already part of an outlined sequence
+	int removed;    // left out of the output, its sequence is reached through a CALL
+	int call;       // subroutine a CALL replaces this line with, -1 if none
+};
+
+struct outline_subroutine {
+	int start;      // line its instructions are copied from
+	int length;
+};
+
+struct outline_window {
+	int start;
+	unsigned long hash;
+};
+
+FILE* outline_begin();
+void outline_end(FILE* stream, FILE* outfile, int report);
+int outline_eligible(const char* line);
+int outline_size(const char* line);
+
+#endif
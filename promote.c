@@ -0,0 +1,101 @@
+#include "promote.h"
+#include "induct.h"
+#include "scratch.h"
+#include "type.h"
+#include "frame.h"
+#include "range.h"
+#include <stdlib.h>
+
+int promote_returns(struct stmt* s) {
+    // true if s can leave the function, which would skip the stores after the loop
+    for (; s; s = s->next) {
+        if (s->kind == STMT_RETURN) return 1;
+        if (promote_returns(s->body) || promote_returns(s->else_body)) return 1;
+    }
+    return 0;
+}
+
+void promote_visit(struct promote_loop* l, struct expr* e) {
+    // counts the reads and writes of each integer global
+    if (!e) return;
+    if (e->kind == EXPR_NAME && e->symbol && e->symbol->kind == SYMBOL_GLOBAL && e->symbol->type->kind == TYPE_INTEGER && !e->symbol->reg) {
+        int i;
+        for (i = 0; i < l->count && l->globals[i].symbol != e->symbol; i++);
+        if (i == l->count) {
+            if (l->count == PROMOTE_CANDIDATES) return;
+            l->globals[i].symbol = e->symbol;
+            l->globals[i].uses = 0;
+            l->globals[i].written = 0;
+            l->globals[i].reg = -1;
+            l->count++;
+        }
+        l->globals[i].uses++;
+    }
+    promote_visit(l, e->left);
+    promote_visit(l, e->right);
+    promote_visit(l, e->next);
+}
+
+void promote_visit_stmt(struct promote_loop* l, struct stmt* s) {
+    for (; s; s = s->next) {
+        if (s->decl) promote_visit(l, s->decl->value);
+        promote_visit(l, s->init_expr);
+        promote_visit(l, s->expr);
+        promote_visit(l, s->next_expr);
+        promote_visit_stmt(l, s->body);
+        promote_visit_stmt(l, s->else_body);
+    }
+}
+
+struct promote_loop* promote_begin(struct stmt* s, FILE* outfile) {
+    // keeps the globals loop s uses most in registers, loaded here before the loop is entered
+    struct promote_loop* l;
+
+    // nothing else can see a global while the loop runs unless it calls a function or leaves early
+    if (induct_calls(s->body) || frame_expr_uses(s->expr, EXPR_CALL) || frame_expr_uses(s->next_expr, EXPR_CALL)) return 0;
+    if (promote_returns(s->body)) return 0;
+
+    int need = induct_need(s->body);
+    if (expr_need(s->expr) > need) need = expr_need(s->expr);
+    if (expr_need(s->next_expr) > need) need = expr_need(s->next_expr);
+    int room = scratch_available() - need - 1;
+    if (room > PROMOTE_MAX_GLOBALS) room = PROMOTE_MAX_GLOBALS;
+    if (room <= 0) return 0;
+
+    l = calloc(1, sizeof(*l));
+    promote_visit(l, s->expr);
+    promote_visit(l, s->next_expr);
+    promote_visit_stmt(l, s->body);
+
+    int promoted = 0;
+    for (; room > 0; room--) {
+        struct promote_global* best = 0;
+        for (int i = 0; i < l->count; i++) {
+            if (l->globals[i].reg < 0 && (!best || l->globals[i].uses > best->uses)) best = &l->globals[i];
+        }
+        if (!best) break;
+        best->reg = scratch_alloc();
+        best->written = range_stmt_assigns(s->body, best->symbol) || range_assigns(s->expr, best->symbol) || range_assigns(s->next_expr, best->symbol);
+        fprintf(outfile, "\tMOVQ %s, %s\n", best->symbol->name, scratch_name(best->reg));
+        best->symbol->reg = scratch_name(best->reg);
+        promoted++;
+    }
+    if (!promoted) {
+        free(l);
+        return 0;
+    }
+    return l;
+}
+
+void promote_end(struct promote_loop* l, FILE* outfile) {
+    // stores what the loop changed and puts the globals back in memory
+    if (!l) return;
+    for (int i = 0; i < l->count; i++) {
+        struct promote_global* g = &l->globals[i];
+        if (g->reg < 0) continue;
+        g->symbol->reg = 0;
+        if (g->written) fprintf(outfile, "\tMOVQ %s, %s\n", scratch_name(g->reg), g->symbol->name);
+        scratch_free(g->reg);
+    }
+    free(l);
+}
@@ -0,0 +1,28 @@
+#ifndef PROMOTE_H
+#define PROMOTE_H
+
+#include <stdio.h>
+#include "stmt.h"
+#include "expr.h"
+#include "symbol.h"
+
+/* most globals one loop keeps in registers, and the most it looks at for them */
+#define PROMOTE_MAX_GLOBALS 3
+#define PROMOTE_CANDIDATES 16
+
+struct promote_global {
+	struct symbol* symbol;
+	int uses;
+	int written; // stored back when the loop is left
+	int reg;     // scratch register it lives in, -1 if the loop cannot spare one
+};
+
+struct promote_loop {
+	struct promote_global globals[PROMOTE_CANDIDATES];
+	int count;
+};
+
+struct promote_loop* promote_begin(struct stmt* s, FILE* outfile);
+void promote_end(struct promote_loop* l, FILE* outfile);
+
+#endif
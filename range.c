@@ -0,0 +1,504 @@
+#include "range.h"
+#include "symbol.h"
+#include "type.h"
+#include <string.h>
+#include <limits.h>
+
+struct range_var {
+	struct symbol *symbol;
+	struct range known; // what reads may assume during the current pass
+	struct range found; // every value assigned during the current pass
+	int growth;         // passes in which found went beyond known
+};
+
+struct range_fact {
+	struct symbol *symbol;
+	struct range range; // holds throughout the statements being walked
+};
+
+struct range_var *range_vars = 0;
+int range_var_count = 0;
+int range_var_capacity = 0;
+
+struct range_fact *range_facts = 0; // from the conditions guarding the current statement, innermost last
+int range_fact_top = 0;
+int range_fact_capacity = 0;
+
+int range_final = 0; // the last pass over a function rewrites what the ranges decide
+int range_report = 0;
+const char *range_function_name = 0;
+
+const struct range range_full = {LONG_MIN, LONG_MAX};
+const struct range range_none = {LONG_MAX, LONG_MIN};
+
+struct range range_make(long low, long high)
+{
+    struct range r = {low, high};
+    return r;
+}
+
+int range_empty(struct range r)
+{
+    return r.low > r.high;
+}
+
+int range_same(struct range a, struct range b)
+{
+    return (range_empty(a) && range_empty(b)) || (a.low == b.low && a.high == b.high);
+}
+
+struct range range_union(struct range a, struct range b)
+{
+    if (range_empty(a))
+        return b;
+    if (range_empty(b))
+        return a;
+    return range_make(a.low < b.low ? a.low : b.low, a.high > b.high ? a.high : b.high);
+}
+
+struct range range_intersect(struct range a, struct range b)
+{
+    return range_make(a.low > b.low ? a.low : b.low, a.high < b.high ? a.high : b.high);
+}
+
+int range_tracked(struct symbol *s)
+{ // integer locals and parameters only change where this function assigns them
+    return s && s->kind != SYMBOL_GLOBAL && s->type && s->type->kind == TYPE_INTEGER;
+}
+
+struct range_var *range_var(struct symbol *s)
+{
+    for (int i = 0; i < range_var_count; i++)
+    {
+        if (range_vars[i].symbol == s)
+            return &range_vars[i];
+    }
+    if (range_var_count == range_var_capacity)
+    {
+        range_var_capacity = range_var_capacity ? range_var_capacity * 2 : 16;
+        range_vars = realloc(range_vars, range_var_capacity * sizeof(*range_vars));
+    }
+    struct range_var *v = &range_vars[range_var_count++];
+    v->symbol = s;
+    v->known = v->found = s->kind == SYMBOL_PARAM ? range_full : range_none; // parameters arrive with any value
+    v->growth = 0;
+    return v;
+}
+
+struct range range_symbol(struct symbol *s)
+{ // what reading s may produce at the current statement
+    if (!range_tracked(s))
+        return s && s->type && s->type->kind == TYPE_BOOLEAN ? range_make(0, 1) : range_full;
+    struct range r = range_var(s)->known;
+    for (int i = 0; i < range_fact_top; i++)
+    {
+        if (range_facts[i].symbol == s)
+            r = range_intersect(r, range_facts[i].range);
+    }
+    return r;
+}
+
+void range_assign(struct expr *target, struct range r)
+{
+    if (target->kind == EXPR_NAME && range_tracked(target->symbol))
+    {
+        struct range_var *v = range_var(target->symbol);
+        v->found = range_union(v->found, r);
+    }
+}
+
+struct range range_arith(expr_t kind, struct range a, struct range b)
+{ // interval arithmetic that gives up on anything that may wrap around
+    long v[4];
+    if (range_empty(a) || range_empty(b))
+        return range_none;
+    switch (kind)
+    {
+    case EXPR_ADD:
+        if (__builtin_add_overflow(a.low, b.low, &v[0]) || __builtin_add_overflow(a.high, b.high, &v[1]))
+            return range_full;
+        return range_make(v[0], v[1]);
+    case EXPR_SUB:
+        if (__builtin_sub_overflow(a.low, b.high, &v[0]) || __builtin_sub_overflow(a.high, b.low, &v[1]))
+            return range_full;
+        return range_make(v[0], v[1]);
+    case EXPR_MUL:
+        if (__builtin_mul_overflow(a.low, b.low, &v[0]) || __builtin_mul_overflow(a.low, b.high, &v[1]) ||
+            __builtin_mul_overflow(a.high, b.low, &v[2]) || __builtin_mul_overflow(a.high, b.high, &v[3]))
+            return range_full;
+        struct range r = range_make(v[0], v[0]);
+        for (int i = 1; i < 4; i++)
+            r = range_union(r, range_make(v[i], v[i]));
+        return r;
+    case EXPR_DIV: // truncates toward zero, so each end is extreme at one end of the divisor
+        if (b.low < 1)
+            return range_full;
+        return range_make(a.low < 0 ? a.low / b.low : a.low / b.high, a.high < 0 ? a.high / b.high : a.high / b.low);
+    case EXPR_MOD: // takes the sign of the dividend and is smaller than both operands
+        if (b.low < 1)
+            return a.low >= 0 ? range_make(0, a.high) : range_full;
+        if (a.low >= 0 && a.high < b.low)
+            return a;
+        return range_make(a.low < 0 ? (a.low > 1 - b.high ? a.low : 1 - b.high) : 0, a.high > 0 ? (a.high < b.high - 1 ? a.high : b.high - 1) : 0);
+    }
+    return range_full;
+}
+
+struct range range_compare(expr_t kind, struct range a, struct range b)
+{ // [1, 1] or [0, 0] when the operands decide the comparison, [0, 1] otherwise
+    int always = 0, never = 0;
+    if (range_empty(a) || range_empty(b))
+        return range_none;
+    switch (kind)
+    {
+    case EXPR_LT:
+        always = a.high < b.low;
+        never = a.low >= b.high;
+        break;
+    case EXPR_LE:
+        always = a.high <= b.low;
+        never = a.low > b.high;
+        break;
+    case EXPR_GT:
+        return range_compare(EXPR_LT, b, a);
+    case EXPR_GE:
+        return range_compare(EXPR_LE, b, a);
+    case EXPR_EQ:
+        always = a.low == a.high && b.low == b.high && a.low == b.low;
+        never = a.high < b.low || b.high < a.low;
+        break;
+    case EXPR_NEQ:
+        always = a.high < b.low || b.high < a.low;
+        never = a.low == a.high && b.low == b.high && a.low == b.low;
+        break;
+    }
+    return range_make(always, !never);
+}
+
+int range_is_comparison(expr_t kind)
+{
+    return kind == EXPR_LT || kind == EXPR_LE || kind == EXPR_GT || kind == EXPR_GE || kind == EXPR_EQ || kind == EXPR_NEQ;
+}
+
+struct range range_expr(struct expr *e)
+{ // the values e may produce, also recorded in e for code generation
+    struct range r = range_full, a, b;
+    if (!e)
+        return range_full;
+
+    switch (e->kind)
+    {
+    case EXPR_INT_LITERAL:
+    case EXPR_BOOL_LITERAL:
+    case EXPR_CHAR_LITERAL:
+        r = range_make(e->literal_value, e->literal_value);
+        break;
+    case EXPR_NAME:
+        r = range_symbol(e->symbol);
+        break;
+    case EXPR_STRING_LITERAL:
+        break;
+    case EXPR_GROUP:
+        r = range_expr(e->right);
+        break;
+    case EXPR_ASSGN:
+        if (e->left->kind != EXPR_NAME)
+            range_expr(e->left);
+        a = range_expr(e->right);
+        range_assign(e->left, a);
+        if (e->left->kind == EXPR_NAME && range_tracked(e->left->symbol))
+            r = a;
+        break;
+    case EXPR_INCR:
+    case EXPR_DECR:
+        a = range_expr(e->left);
+        b = range_arith(e->kind == EXPR_INCR ? EXPR_ADD : EXPR_SUB, a, range_make(1, 1));
+        range_assign(e->left, b);
+        r = range_union(a, b);
+        break;
+    case EXPR_NOT: // booleans are 0 or 1
+        a = range_expr(e->right);
+        r = range_empty(a) ? range_none : range_make(1 - (a.high > 1 ? 1 : a.high), 1 - (a.low < 0 ? 0 : a.low));
+        break;
+    case EXPR_NEG:
+        a = range_expr(e->right);
+        r = range_empty(a) ? range_none : a.low == LONG_MIN ? range_full : range_make(-a.high, -a.low);
+        break;
+    case EXPR_CALL:
+        for (struct expr *arg = e->right; arg; arg = arg->next)
+            range_expr(arg);
+        if (e->left->symbol && e->left->symbol->type->subtype->kind == TYPE_BOOLEAN)
+            r = range_make(0, 1);
+        break;
+    case EXPR_ARRACC:
+        range_expr(e->right);
+        break;
+    default:
+        a = range_expr(e->left);
+        b = range_expr(e->right);
+        if (range_is_comparison(e->kind))
+            r = range_compare(e->kind, a, b);
+        else if (e->kind == EXPR_AND)
+            r = range_empty(a) || range_empty(b) ? range_none : range_make(a.low > 0 && b.low > 0, a.high > 0 && b.high > 0);
+        else if (e->kind == EXPR_OR)
+            r = range_empty(a) || range_empty(b) ? range_none : range_make(a.low > 0 || b.low > 0, a.high > 0 || b.high > 0);
+        else
+            r = range_arith(e->kind, a, b);
+    }
+
+    if (range_final && r.low == r.high && (range_is_comparison(e->kind) || e->kind == EXPR_AND || e->kind == EXPR_OR || e->kind == EXPR_NOT) && !expr_has_side_effects(e))
+    { // the condition comes out the same every time
+        if (range_report && range_is_comparison(e->kind))
+            fprintf(stderr, "range: comparison in %s is always %s\n", range_function_name, r.low ? "true" : "false");
+        e->kind = EXPR_BOOL_LITERAL;
+        e->literal_value = r.low;
+        e->left = 0;
+        e->right = 0;
+        e->symbol = 0;
+    }
+    e->ranged = 1;
+    e->low = r.low;
+    e->high = r.high;
+    return r;
+}
+
+int range_assigns(struct expr *e, struct symbol *s)
+{ // true if e may write s
+    if (!e)
+        return 0;
+    if ((e->kind == EXPR_ASSGN || e->kind == EXPR_INCR || e->kind == EXPR_DECR) && e->left && e->left->symbol == s)
+        return 1;
+    return range_assigns(e->left, s) || range_assigns(e->right, s) || range_assigns(e->next, s);
+}
+
+int range_stmt_assigns(struct stmt *s, struct symbol *sym)
+{
+    for (; s; s = s->next)
+    {
+        if (s->decl && range_assigns(s->decl->value, sym))
+            return 1;
+        if (range_assigns(s->init_expr, sym) || range_assigns(s->expr, sym) || range_assigns(s->next_expr, sym))
+            return 1;
+        if (range_stmt_assigns(s->body, sym) || range_stmt_assigns(s->else_body, sym))
+            return 1;
+    }
+    return 0;
+}
+
+int range_refine_name(struct expr *x, expr_t kind, struct expr *other, struct stmt *region, struct expr *also)
+{ // records what "x kind other" says about x, as long as x keeps its value through region and also
+    struct range r = range_full;
+    while (x->kind == EXPR_GROUP)
+        x = x->right;
+    if (x->kind != EXPR_NAME || !range_tracked(x->symbol) || !other->ranged || other->low > other->high)
+        return 0;
+    if (range_stmt_assigns(region, x->symbol) || range_assigns(also, x->symbol))
+        return 0;
+
+    switch (kind)
+    {
+    case EXPR_LT:
+        r = other->high == LONG_MIN ? range_none : range_make(LONG_MIN, other->high - 1);
+        break;
+    case EXPR_LE:
+        r.high = other->high;
+        break;
+    case EXPR_GT:
+        r = other->low == LONG_MAX ? range_none : range_make(other->low + 1, LONG_MAX);
+        break;
+    case EXPR_GE:
+        r.low = other->low;
+        break;
+    case EXPR_EQ:
+        r = range_make(other->low, other->high);
+        break;
+    default:
+        return 0;
+    }
+
+    if (range_fact_top == range_fact_capacity)
+    {
+        range_fact_capacity = range_fact_capacity ? range_fact_capacity * 2 : 16;
+        range_facts = realloc(range_facts, range_fact_capacity * sizeof(*range_facts));
+    }
+    range_facts[range_fact_top].symbol = x->symbol;
+    range_facts[range_fact_top].range = r;
+    range_fact_top++;
+    return 1;
+}
+
+int range_refine(struct expr *cond, int when, struct stmt *region, struct expr *also)
+{ // records what cond having the truth value when says about the variables, returns the number of facts added
+    if (!cond)
+        return 0;
+    switch (cond->kind)
+    {
+    case EXPR_GROUP:
+        return range_refine(cond->right, when, region, also);
+    case EXPR_NOT:
+        return range_refine(cond->right, !when, region, also);
+    case EXPR_AND:
+    case EXPR_OR:
+        if ((cond->kind == EXPR_AND) != when)
+            return 0; // either side alone could have decided it
+        return range_refine(cond->left, when, region, also) + range_refine(cond->right, when, region, also);
+    }
+    if (!range_is_comparison(cond->kind))
+        return 0;
+    expr_t kind = when ? cond->kind : expr_negate(cond->kind);
+    return range_refine_name(cond->left, kind, cond->right, region, also) + range_refine_name(cond->right, expr_mirror(kind), cond->left, region, also);
+}
+
+void range_if(struct stmt *s)
+{
+    struct range c = range_expr(s->expr);
+    int n;
+
+    if (range_final && s->expr->kind == EXPR_BOOL_LITERAL)
+    { // only one arm can ever run, so the statement becomes that arm
+        struct stmt *arm = s->expr->literal_value ? s->body : s->else_body;
+        s->kind = STMT_BLOCK;
+        s->expr = 0;
+        s->body = arm;
+        s->else_body = 0;
+        range_stmt(arm);
+        return;
+    }
+
+    int pure = !expr_has_side_effects(s->expr);
+    if (c.high != 0)
+    {
+        n = pure ? range_refine(s->expr, 1, s->body, 0) : 0;
+        range_stmt(s->body);
+        range_fact_top -= n;
+    }
+    if (c.low != 1)
+    {
+        n = pure ? range_refine(s->expr, 0, s->else_body, 0) : 0;
+        range_stmt(s->else_body);
+        range_fact_top -= n;
+    }
+}
+
+void range_for(struct stmt *s)
+{
+    range_expr(s->init_expr);
+    struct range c = s->expr ? range_expr(s->expr) : range_make(1, 1);
+    if (c.high == 0)
+        return; // the body never runs
+    int pure = s->expr && !expr_has_side_effects(s->expr);
+
+    int n = pure ? range_refine(s->expr, 1, s->body, 0) : 0;
+    range_stmt(s->body);
+    range_fact_top -= n;
+
+    // the step reads its variables before its own assignment, so the condition still holds for those reads
+    struct expr *step = s->next_expr;
+    struct expr *before = step;
+    if (step && (step->kind == EXPR_INCR || step->kind == EXPR_DECR))
+        before = 0;
+    else if (step && step->kind == EXPR_ASSGN && step->left->kind == EXPR_NAME)
+        before = step->right;
+    n = pure ? range_refine(s->expr, 1, s->body, before) : 0;
+    range_expr(step);
+    range_fact_top -= n;
+}
+
+void range_stmt(struct stmt *s)
+{
+    for (; s; s = s->next)
+    {
+        switch (s->kind)
+        {
+        case STMT_DECL:
+            for (struct decl *d = s->decl; d; d = d->next)
+            {
+                struct range r = d->value ? range_expr(d->value) : range_make(0, 0); // locals start out zero
+                if (range_tracked(d->symbol))
+                {
+                    struct range_var *v = range_var(d->symbol);
+                    v->found = range_union(v->found, r);
+                }
+            }
+            break;
+        case STMT_EXPR:
+        case STMT_RETURN:
+            range_expr(s->expr);
+            break;
+        case STMT_PRINT:
+            for (struct expr *e = s->expr; e; e = e->next)
+                range_expr(e);
+            break;
+        case STMT_BLOCK:
+            range_stmt(s->body);
+            break;
+        case STMT_IF_ELSE:
+            range_if(s);
+            break;
+        case STMT_FOR:
+            range_for(s);
+            break;
+        }
+    }
+}
+
+void range_function(struct decl *d, int report)
+{ // finds the values of every integer local and parameter of d, then annotates and folds its code with them
+    int changed = 1;
+    range_var_count = 0;
+    range_fact_top = 0;
+    range_function_name = d->name;
+
+    // grow every variable until the assignments produce nothing new, widening the ones that keep growing
+    while (changed)
+    {
+        changed = 0;
+        for (int i = 0; i < range_var_count; i++)
+            range_vars[i].found = range_vars[i].known;
+        range_stmt(d->code);
+        for (int i = 0; i < range_var_count; i++)
+        {
+            struct range_var *v = &range_vars[i];
+            if (range_same(v->found, v->known))
+                continue;
+            changed = 1;
+            if (++v->growth > RANGE_WIDEN_AFTER && !range_empty(v->known))
+            {
+                if (v->found.low < v->known.low)
+                    v->found.low = LONG_MIN;
+                if (v->found.high > v->known.high)
+                    v->found.high = LONG_MAX;
+            }
+            v->known = v->found;
+        }
+    }
+
+    // then keep only what the assignments can produce from those ranges
+    for (int pass = 0; pass < RANGE_NARROW_PASSES; pass++)
+    {
+        for (int i = 0; i < range_var_count; i++)
+            range_vars[i].found = range_vars[i].symbol->kind == SYMBOL_PARAM ? range_full : range_none;
+        range_stmt(d->code);
+        for (int i = 0; i < range_var_count; i++)
+            range_vars[i].known = range_intersect(range_vars[i].known, range_vars[i].found);
+    }
+
+    range_final = 1;
+    range_report = report;
+    range_stmt(d->code);
+    range_final = 0;
+}
+
+void range_program(struct decl *program, int report)
+{
+    for (struct decl *d = program; d; d = d->next)
+    {
+        if (d->type->kind == TYPE_FUNCTION && d->code)
+            range_function(d, report);
+    }
+}
+
+int range_within(struct expr *e, long low, long high)
+{ // true if range analysis showed e stays between low and high
+    return e && e->ranged && e->low <= e->high && e->low >= low && e->high <= high;
+}
@@ -0,0 +1,26 @@
+#ifndef RANGE_H
+#define RANGE_H
+
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+
+/* passes in a row a variable may keep growing before its moving bounds are widened to infinity */
+#define RANGE_WIDEN_AFTER 3
+/* passes that shrink the widened bounds back to what the assignments actually produce */
+#define RANGE_NARROW_PASSES 2
+
+struct range {
+	long low;
+	long high;   // empty when low > high, for code that cannot run
+};
+
+struct range range_expr(struct expr *e);
+void range_stmt(struct stmt *s);
+void range_function(struct decl *d, int report);
+void range_program(struct decl *program, int report);
+int range_within(struct expr *e, long low, long high);
+int range_assigns(struct expr *e, struct symbol *s);
+int range_stmt_assigns(struct stmt *s, struct symbol *sym);
+
+#endif
@@ -0,0 +1,320 @@
+#include "sched.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+char* sched_text = 0;
+size_t sched_size = 0;
+int sched_latency[SCHED_MAX_BLOCK][SCHED_MAX_BLOCK]; // edge latency between two instructions of a block, -1 for none
+
+// latencies and divider occupancy in the range of recent Intel and AMD cores (Agner Fog's instruction tables)
+const struct sched_info sched_table[] = {
+    {"MOVQ", SCHED_MOVE, 1, 1},
+    {"MOVL", SCHED_MOVE, 1, 1},
+    {"MOVB", SCHED_MOVE, 1, 1},
+    {"MOVZBQ", SCHED_MOVE, 1, 1},
+    {"LEAQ", SCHED_LEA, 1, 1},
+    {"ADDQ", SCHED_ALU, 1, 1},
+    {"SUBQ", SCHED_ALU, 1, 1},
+    {"ANDQ", SCHED_ALU, 1, 1},
+    {"ORQ", SCHED_ALU, 1, 1},
+    {"XORQ", SCHED_ALU, 1, 1},
+    {"XORL", SCHED_ALU, 1, 1},
+    {"SHLQ", SCHED_ALU, 1, 1},
+    {"SHRQ", SCHED_ALU, 1, 1},
+    {"INCQ", SCHED_ALU, 1, 1},
+    {"DECQ", SCHED_ALU, 1, 1},
+    {"NEG", SCHED_ALU, 1, 1},
+    {"NEGQ", SCHED_ALU, 1, 1},
+    {"IMULQ", SCHED_ALU, 3, 1},
+    {"CMPQ", SCHED_COMPARE, 1, 1},
+    {"CMP", SCHED_COMPARE, 1, 1},
+    {"TESTQ", SCHED_COMPARE, 1, 1},
+    {"CQTO", SCHED_CONVERT, 1, 1},
+    {"IDIVQ", SCHED_DIVIDE, 40, 20},
+    {"DIVQ", SCHED_DIVIDE, 35, 20},
+    {"DIVL", SCHED_DIVIDE, 26, 6},
+    {"SET", SCHED_SET, 1, 1},   // any condition
+    {"CMOV", SCHED_CMOV, 1, 1}, // any condition
+    {0}
+};
+
+FILE* sched_begin() {
+    // the code generator writes into memory, sched_end reorders it on the way to the real output
+    return open_memstream(&sched_text, &sched_size);
+}
+
+int sched_register(const char* name) {
+    // number of the 64 bit register that contains the named one, -1 if it is none
+    static const char* names[] = {"ax", "bx", "cx", "dx", "si", "di", "bp", "sp"};
+    if (*name == '%') name++;
+    if (name[0] == 'r' && isdigit(name[1])) return atoi(name + 1); // r8 to r15 and their b, w, d parts
+    if (name[0] == 'r' || name[0] == 'e') name++;
+    for (int i = 0; i < 8; i++) {
+        if (!strncmp(name, names[i], 2)) return i;
+        if (name[1] == 'l' && name[0] == names[i][0] && i < 4) return i; // al, bl, cl, dl
+    }
+    if (!strcmp(name, "sil")) return 4;
+    if (!strcmp(name, "dil")) return 5;
+    return -1;
+}
+
+int sched_may_alias(const char* a, const char* b) {
+    // frame slots only alias frame slots that overlap them, globals only themselves, and pointers any global
+    int frame_a = strstr(a, "(%rbp)") != 0;
+    int frame_b = strstr(b, "(%rbp)") != 0;
+    if (frame_a || frame_b) {
+        if (!(frame_a && frame_b)) return 0;
+        return abs(atoi(a) - atoi(b)) < 8;
+    }
+    int symbol_a = isalpha(*a) || *a == '_';
+    int symbol_b = isalpha(*b) || *b == '_';
+    if (!symbol_a || !symbol_b) return 1;
+    size_t length_a = strcspn(a, "+-(");
+    size_t length_b = strcspn(b, "+-(");
+    return length_a == length_b && !strncmp(a, b, length_a);
+}
+
+int sched_operand_registers(const char* operand) {
+    // registers an operand reads to form its address, or the register itself
+    int mask = 0;
+    for (const char* p = strchr(operand, '%'); p; p = strchr(p + 1, '%')) {
+        int r = sched_register(p);
+        if (r >= 0) mask |= 1 << r;
+    }
+    return mask;
+}
+
+int sched_parse(char* line, struct sched_insn* insn) {
+    // describes one line of assembly, returns 0 for anything that has to stay where it is
+    char mnemonic[16];
+    char operands[3][64];
+    int count = 0;
+
+    memset(insn, 0, sizeof(*insn));
+    insn->text = line;
+    if (line[0] != '\t' || line[1] == '.' || strstr(line, "%rsp")) return 0;
+
+    const char* p = line + 1;
+    size_t length = strcspn(p, " \n");
+    if (length >= sizeof(mnemonic)) return 0;
+    memcpy(mnemonic, p, length);
+    mnemonic[length] = 0;
+    for (const struct sched_info* info = sched_table; info->mnemonic; info++) {
+        if (!strcmp(mnemonic, info->mnemonic) || ((info->kind == SCHED_SET || info->kind == SCHED_CMOV) && !strncmp(mnemonic, info->mnemonic, strlen(info->mnemonic)))) {
+            insn->info = info;
+            break;
+        }
+    }
+    if (!insn->info) return 0;
+
+    // operands are separated by commas outside of parentheses
+    p += length;
+    while (*p == ' ') p++;
+    while (*p && *p != '\n') {
+        int depth = 0;
+        size_t n = 0;
+        if (count == 3) return 0;
+        while (*p && *p != '\n' && (depth || *p != ',')) {
+            if (*p == '(') depth++;
+            if (*p == ')') depth--;
+            if (n < sizeof(operands[0]) - 1) operands[count][n++] = *p;
+            p++;
+        }
+        operands[count++][n] = 0;
+        if (*p == ',') p++;
+        while (*p == ' ') p++;
+    }
+
+    int last = count - 1;
+    for (int i = 0; i < count; i++) {
+        char* op = operands[i];
+        if (op[0] == '$') continue;
+        if (op[0] != '%') {
+            if (insn->mem) return 0; // one memory operand at most
+            insn->mem = strdup(op);
+        }
+        insn->reads |= sched_operand_registers(op);
+    }
+
+    int dest = count ? (operands[last][0] == '%' ? sched_register(operands[last]) : -1) : -1;
+    int dest_is_mem = count && operands[last][0] != '%' && operands[last][0] != '$';
+    switch (insn->info->kind) {
+        case SCHED_MOVE:
+            if (dest >= 0) {
+                insn->reads &= ~(1 << dest) | (count > 1 ? sched_operand_registers(operands[0]) : 0);
+                insn->writes |= 1 << dest;
+            }
+            insn->mem_write = dest_is_mem;
+            insn->loads = insn->mem && !dest_is_mem;
+            break;
+        case SCHED_LEA:
+            free(insn->mem); // only the address is computed, memory is not touched
+            insn->mem = 0;
+            if (dest >= 0) {
+                insn->reads = sched_operand_registers(operands[0]);
+                insn->writes |= 1 << dest;
+            }
+            break;
+        case SCHED_ALU:
+            if (count == 3 && dest >= 0) { // three operand IMULQ only writes its destination
+                insn->reads = sched_operand_registers(operands[1]);
+            }
+            if (dest >= 0) insn->writes |= 1 << dest;
+            insn->writes |= 1 << SCHED_FLAGS;
+            insn->mem_write = dest_is_mem;
+            insn->loads = insn->mem != 0;
+            break;
+        case SCHED_COMPARE:
+            insn->writes |= 1 << SCHED_FLAGS;
+            insn->loads = insn->mem != 0;
+            break;
+        case SCHED_DIVIDE:
+            insn->reads |= (1 << 0) | (1 << 3);
+            insn->writes |= (1 << 0) | (1 << 3) | (1 << SCHED_FLAGS);
+            insn->loads = insn->mem != 0;
+            break;
+        case SCHED_CONVERT:
+            insn->reads |= 1 << 0;
+            insn->writes |= 1 << 3;
+            break;
+        case SCHED_SET:
+        case SCHED_CMOV: // both merge into the old value of the destination
+            insn->reads |= 1 << SCHED_FLAGS;
+            if (dest >= 0) insn->writes |= 1 << dest;
+            insn->mem_write = dest_is_mem;
+            insn->loads = insn->mem && !dest_is_mem;
+            break;
+    }
+    return 1;
+}
+
+void sched_edge(int from, int to, int latency) {
+    if (sched_latency[from][to] < latency) sched_latency[from][to] = latency;
+}
+
+void sched_block(struct sched_insn* insns, int count, FILE* outfile) {
+    // list scheduling: each cycle issues the ready instructions on the longest remaining latency path first
+    const int flags = 1 << SCHED_FLAGS;
+    int last_reader[SCHED_MAX_BLOCK]; // last instruction reading the flags an instruction sets, count if they leave the block
+    int i, j;
+
+    for (i = 0; i < count; i++) {
+        for (j = 0; j < count; j++) sched_latency[i][j] = -1;
+        last_reader[i] = -1;
+    }
+
+    for (j = 0; j < count; j++) {
+        for (i = 0; i < j; i++) {
+            int latency = insns[i].info->latency + (insns[i].loads ? SCHED_LOAD_LATENCY : 0);
+            if (insns[i].writes & insns[j].reads & ~flags) sched_edge(i, j, latency);
+            if ((insns[i].reads & insns[j].writes & ~flags) || (insns[i].writes & insns[j].writes & ~flags)) sched_edge(i, j, 0);
+            if (insns[i].mem && insns[j].mem && (insns[i].mem_write || insns[j].mem_write) && sched_may_alias(insns[i].mem, insns[j].mem)) {
+                sched_edge(i, j, insns[i].mem_write && insns[j].loads ? latency : 0);
+            }
+        }
+    }
+
+    // the flags are rewritten by almost everything, so only order the writes that something reads
+    int current = -1;
+    for (j = 0; j < count; j++) {
+        if (insns[j].reads & flags) {
+            if (current >= 0) {
+                sched_edge(current, j, insns[current].info->latency);
+                last_reader[current] = j;
+            } else {
+                for (i = j + 1; i < count; i++) {
+                    if (insns[i].writes & flags) sched_edge(j, i, 0); // flags from before the block
+                }
+            }
+        }
+        if (insns[j].writes & flags) current = j;
+    }
+    if (current >= 0) last_reader[current] = count; // whatever follows the block may test them
+    for (i = 0; i < count; i++) {
+        if (last_reader[i] < 0) continue;
+        for (j = 0; j < count; j++) { // no other flag write may land between i and its readers
+            if (j == i || !(insns[j].writes & flags)) continue;
+            if (j < i) sched_edge(j, i, 0);
+            else if (last_reader[i] < count && j > last_reader[i]) sched_edge(last_reader[i], j, 0);
+        }
+    }
+
+    for (i = count - 1; i >= 0; i--) {
+        insns[i].priority = insns[i].info->latency;
+        for (j = i + 1; j < count; j++) {
+            if (sched_latency[i][j] >= 0) {
+                insns[j].preds++;
+                if (sched_latency[i][j] + insns[j].priority > insns[i].priority) insns[i].priority = sched_latency[i][j] + insns[j].priority;
+            }
+        }
+    }
+
+    int cycle = 0;
+    int divider_free = 0;
+    int scheduled = 0;
+    while (scheduled < count) {
+        for (int issued = 0; issued < SCHED_ISSUE_WIDTH; issued++) {
+            int best = -1;
+            for (i = 0; i < count; i++) {
+                if (insns[i].done || insns[i].preds || insns[i].ready > cycle) continue;
+                if (insns[i].info->throughput > 1 && divider_free > cycle) continue;
+                if (best < 0 || insns[i].priority > insns[best].priority) best = i;
+            }
+            if (best < 0) break;
+
+            fputs(insns[best].text, outfile);
+            insns[best].done = 1;
+            scheduled++;
+            if (insns[best].info->throughput > 1) divider_free = cycle + insns[best].info->throughput;
+            for (j = best + 1; j < count; j++) {
+                if (sched_latency[best][j] < 0) continue;
+                insns[j].preds--;
+                if (cycle + sched_latency[best][j] > insns[j].ready) insns[j].ready = cycle + sched_latency[best][j];
+            }
+        }
+        cycle++;
+    }
+
+    for (i = 0; i < count; i++) {
+        free(insns[i].mem);
+        free(insns[i].text);
+    }
+}
+
+void sched_end(FILE* stream, FILE* outfile) {
+    // splits the code into basic blocks at labels, directives, control flow and stack operations and schedules each one
+    static struct sched_insn block[SCHED_MAX_BLOCK];
+    int count = 0;
+
+    fclose(stream);
+    char* line = sched_text;
+    while (line && *line) {
+        char* end = strchr(line, '\n');
+        char* next = end ? end + 1 : 0;
+        size_t length = end ? (size_t)(end - line + 1) : strlen(line);
+        char* text = malloc(length + 1);
+        memcpy(text, line, length);
+        text[length] = 0;
+
+        struct sched_insn insn;
+        if (sched_parse(text, &insn)) {
+            if (count == SCHED_MAX_BLOCK) { // a very long block is scheduled in pieces
+                sched_block(block, count, outfile);
+                count = 0;
+            }
+            block[count++] = insn;
+        } else {
+            sched_block(block, count, outfile);
+            count = 0;
+            fputs(text, outfile);
+            free(insn.mem);
+            free(text);
+        }
+        line = next;
+    }
+    sched_block(block, count, outfile);
+    free(sched_text);
+    sched_text = 0;
+    sched_size = 0;
+}
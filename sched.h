@@ -0,0 +1,52 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdio.h>
+
+/* machine model: instructions issued per cycle and the extra latency of a value loaded from memory */
+#define SCHED_ISSUE_WIDTH 4
+#define SCHED_LOAD_LATENCY 5
+#define SCHED_MAX_BLOCK 256
+
+#define SCHED_FLAGS 16 // register number of the condition flags
+
+typedef enum {
+	SCHED_MOVE,     // writes the last operand from the others
+	SCHED_LEA,      // like a move, but the source is only an address
+	SCHED_ALU,      // reads and writes the last operand and sets the flags
+	SCHED_COMPARE,  // reads every operand and sets the flags
+	SCHED_DIVIDE,   // divides rdx:rax by its operand
+	SCHED_CONVERT,  // sign extends rax into rdx
+	SCHED_SET,      // writes the low byte of its operand from the flags
+	SCHED_CMOV      // conditionally moves into the last operand
+} sched_kind_t;
+
+struct sched_info {
+	const char *mnemonic;
+	sched_kind_t kind;
+	int latency;     // cycles until the result can be used
+	int throughput;  // cycles the unit stays busy, more than one only for the divider
+};
+
+struct sched_insn {
+	char *text;
+	const struct sched_info *info;
+	int reads;            // registers as a bit mask, SCHED_FLAGS included
+	int writes;
+	char *mem;            // memory operand, if any
+	int mem_write;
+	int loads;
+	int priority;         // longest latency path from here to the end of the block
+	int preds;            // predecessors not yet scheduled
+	int ready;            // earliest cycle all inputs are available
+	int done;
+};
+
+FILE* sched_begin();
+void sched_end(FILE* stream, FILE* outfile);
+void sched_block(struct sched_insn* insns, int count, FILE* outfile);
+int sched_parse(char* line, struct sched_insn* insn);
+int sched_register(const char* name);
+int sched_may_alias(const char* a, const char* b);
+
+#endif
@@ -84,7 +84,7 @@ struct symbol* scope_lookup( const char* name ) { // search stack for hash table
                 return 0;
             }
         } else {
-            return symbol_copy(res);
+            return res; // every use shares the declaration's symbol, so the frame layout reaches all of them
         }
     }
     return 0;
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 int scratch_table[7]; // simple array that contains status
+int scratch_used = 0; // bit mask of every register handed out since the function started
 
 void scratch_init() {
     for (int i = 0; i < 7; i++) {
@@ -15,6 +16,7 @@ int scratch_alloc() {
     for (int i = 0; i < 7; i++) {
         if (!scratch_table[i]) { // if entry not in use
             scratch_table[i] = 1;
+            scratch_used |= 1 << i;
             return i;
         }
     }
@@ -25,6 +27,15 @@ int scratch_alloc() {
 }
 
 
+int scratch_available() {
+    /*Count registers not in use*/
+    int count = 0;
+    for (int i = 0; i < 7; i++) {
+        if (!scratch_table[i]) count++;
+    }
+    return count;
+}
+
 void scratch_free(int r) {
     if (r > 6 || r < 0) {
         fprintf(stderr, "code generator error: register number %i does not exist\n", r);
@@ -61,6 +72,48 @@ const char* scratch_name(int r) {
     return "ERR";
 }
 
+const char* scratch_byte_name(int r) {
+    /*Low byte of the register, as written by SETcc*/
+    switch(r) {
+        case 0:
+            return "%bl";
+        case 1:
+            return "%r10b";
+        case 2:
+            return "%r11b";
+        case 3:
+            return "%r12b";
+        case 4:
+            return "%r13b";
+        case 5:
+            return "%r14b";
+        case 6:
+            return "%r15b";
+    }
+    return "ERR";
+}
+
+const char* scratch_long_name(int r) {
+    /*Low 32 bits of the register, for operations on values known to fit*/
+    switch(r) {
+        case 0:
+            return "%ebx";
+        case 1:
+            return "%r10d";
+        case 2:
+            return "%r11d";
+        case 3:
+            return "%r12d";
+        case 4:
+            return "%r13d";
+        case 5:
+            return "%r14d";
+        case 6:
+            return "%r15d";
+    }
+    return "ERR";
+}
+
 const char* arg_name(int a) {
     switch(a) {
         case 0:
@@ -81,5 +134,55 @@ const char* arg_name(int a) {
         case 5:
             return "%r9";
             break;
+        case 6:
+            return "%rax"; // only calls between our own functions pass a seventh argument in a register
+            break;
+    }
+    return "ERR";
+}
+
+int stack_depth = 0; // bytes pushed since %rbp, which is 16 byte aligned
+
+void stack_push(const char* reg, FILE* outfile) {
+    fprintf(outfile, "\tPUSHQ %s\n", reg);
+    stack_depth += 8;
+}
+
+void stack_pop(const char* reg, FILE* outfile) {
+    fprintf(outfile, "\tPOPQ %s\n", reg);
+    stack_depth -= 8;
+}
+
+int scratch_save(int all, FILE* outfile) {
+    /*Push the registers holding values that a call may clobber and release them, returns them as a bit mask.
+    Our own functions may clobber every scratch register, System V ones only r10 and r11*/
+    int saved = 0;
+    for (int i = 0; i < 7; i++) {
+        if (scratch_table[i] && (all || i == 1 || i == 2)) {
+            stack_push(scratch_name(i), outfile);
+            scratch_table[i] = 0;
+            saved |= 1 << i;
+        }
+    }
+    return saved;
+}
+
+void scratch_restore(int saved, FILE* outfile) {
+    /*Pop what scratch_save pushed back into the same registers*/
+    for (int i = 6; i >= 0; i--) {
+        if (saved & (1 << i)) {
+            stack_pop(scratch_name(i), outfile);
+            scratch_table[i] = 1;
+        }
     }
 }
+
+void scratch_call(const char* function, FILE* outfile) {
+    /*Call a System V function with the stack 16 byte aligned*/
+    int saved = scratch_save(0, outfile);
+    int pad = stack_depth % 16;
+    if (pad) fprintf(outfile, "\tSUBQ $%i, %%rsp\n", 16 - pad);
+    fprintf(outfile, "\tCALL %s\n", function);
+    if (pad) fprintf(outfile, "\tADDQ $%i, %%rsp\n", 16 - pad);
+    scratch_restore(saved, outfile);
+}
@@ -1,9 +1,27 @@
 #ifndef SCRATCH_H
 #define SCRATCH_H
 
+#include <stdio.h>
+
+/* register arguments of the System V convention and of calls between our own functions */
+#define ARGS_SYSTEM_V 6
+#define ARGS_INTERNAL 7
+
+extern int stack_depth;
+extern int scratch_used;
+
 int scratch_alloc();
+int scratch_available();
 void scratch_free(int r);
 const char* scratch_name(int r);
+const char* scratch_byte_name(int r);
+const char* scratch_long_name(int r);
 const char* arg_name(int a);
 
+void stack_push(const char* reg, FILE* outfile);
+void stack_pop(const char* reg, FILE* outfile);
+int scratch_save(int all, FILE* outfile);
+void scratch_restore(int saved, FILE* outfile);
+void scratch_call(const char* function, FILE* outfile);
+
 #endif
\ No newline at end of file
@@ -1,8 +1,13 @@
+#include <limits.h>
 #include "stmt.h"
 #include "scope.h"
 #include "scratch.h"
 #include "label.h"
 #include "library.h"
+#include "layout.h"
+#include "induct.h"
+#include "promote.h"
+#include "eval.h"
 
 extern int typerr;
 extern int isvoid;
@@ -156,6 +161,30 @@ void stmt_delete(struct stmt *s)
         free(s);
 }
 
+struct stmt *stmt_copy(struct stmt *s)
+{ // deep copy of the statement list, the declarations in it keep their symbols
+    if (!s)
+        return 0;
+    struct stmt *c = stmt_create(s->kind, decl_copy(s->decl), expr_copy(s->init_expr), expr_copy(s->expr), expr_copy(s->next_expr),
+                                 stmt_copy(s->body), stmt_copy(s->else_body), stmt_copy(s->next));
+    c->parent_function = s->parent_function;
+    return c;
+}
+
+int stmt_size(struct stmt *s)
+{ // statement and expression nodes in the list, to bound passes that copy code
+    int n = 0;
+    for (; s; s = s->next)
+    {
+        n += 1 + expr_size(s->init_expr) + expr_size(s->next_expr) + stmt_size(s->body) + stmt_size(s->else_body);
+        for (struct expr *e = s->expr; e; e = e->next)
+            n += expr_size(e);
+        for (struct decl *d = s->decl; d; d = d->next)
+            n += expr_size(d->value);
+    }
+    return n;
+}
+
 void stmt_resolve(struct stmt *s, int print)
 {
     if (!s)
@@ -279,6 +308,258 @@ void stmt_typecheck(struct stmt *s)
     stmt_typecheck(s->next);
 }
 
+struct expr *stmt_assignment(struct stmt *s)
+{ // the assignment to a scalar variable that s consists of, or 0
+    while (s && s->kind == STMT_BLOCK && !s->next)
+        s = s->body;
+    if (!s || s->next || s->kind != STMT_EXPR || s->expr->kind != EXPR_ASSGN || !expr_is_operand(s->expr->left))
+        return 0;
+    return s->expr;
+}
+
+int stmt_codegen_select(struct stmt *s, FILE *outfile)
+{ // if-converts if (c) x = a; else x = b; into a conditional move, returns 0 without emitting anything when it does not apply
+    struct expr *then_assign = stmt_assignment(s->body);
+    struct expr *else_assign = stmt_assignment(s->else_body);
+    if (!then_assign || (s->else_body && !else_assign) || expr_has_side_effects(s->expr))
+        return 0;
+
+    struct expr *x = then_assign->left;
+    struct expr *a = then_assign->right;
+    struct expr *b = else_assign ? else_assign->right : x; // without an else x keeps its value
+    if (else_assign && !expr_same_variable(x, else_assign->left))
+        return 0;
+    if (!expr_can_speculate(a, s->expr) || !expr_can_speculate(b, s->expr) || expr_size(a) > STMT_SELECT_SIZE || expr_size(b) > STMT_SELECT_SIZE)
+        return 0;
+
+    // CMOVcc reads a register or memory, never an immediate
+    const char *source = expr_is_operand(a) && !expr_literal(a, 0) ? expr_operand(a) : 0;
+    if (expr_need(b) > scratch_available() || (!source && expr_need(a) + 1 > scratch_available()) || expr_need(s->expr) + 2 > scratch_available())
+        return 0;
+
+    expr_codegen(b, outfile);
+    if (!source) {
+        expr_codegen(a, outfile);
+        source = scratch_name(a->reg);
+    }
+    expr_t cond = expr_codegen_condition(s->expr, outfile); // the flags must come last, the arms may clobber them
+    fprintf(outfile, "\tCMOV%s %s, %s\n", expr_jump_name(cond, 1) + 1, source, scratch_name(b->reg));
+    fprintf(outfile, "\tMOVQ %s, %s\n", scratch_name(b->reg), symbol_codegen(x->symbol));
+    if (!expr_is_operand(a) || expr_literal(a, 0))
+        scratch_free(a->reg);
+    scratch_free(b->reg);
+    return 1;
+}
+
+struct stmt_case
+{
+    long value;
+    int order; // position in the chain, the first test of a value is the one that counts
+    int body;
+};
+
+int stmt_case_compare(const void *a, const void *b)
+{
+    const struct stmt_case *x = a, *y = b;
+    if (x->value != y->value)
+        return x->value < y->value ? -1 : 1;
+    return x->order - y->order;
+}
+
+int stmt_case_constant(struct expr *e, long *value)
+{ // a literal, or arithmetic on literals such as 0 - 7, small enough to be an immediate
+    if (expr_literal(e, value))
+        return 1;
+    long v;
+    if (!eval_constant(e, &v) || v < INT_MIN || v > INT_MAX)
+        return 0;
+    if (value)
+        *value = v;
+    return 1;
+}
+
+int stmt_case_values(struct expr *cond, struct expr **subject, struct stmt_case *cases, int *count, int body)
+{ // adds the literals that cond compares subject with for equality, returns 0 if cond tests anything else
+    long value;
+    struct expr *other;
+    while (cond->kind == EXPR_GROUP)
+        cond = cond->right;
+    if (cond->kind == EXPR_OR)
+        return stmt_case_values(cond->left, subject, cases, count, body) && stmt_case_values(cond->right, subject, cases, count, body);
+    if (cond->kind != EXPR_EQ)
+        return 0;
+    if (stmt_case_constant(cond->right, &value))
+        other = cond->left;
+    else if (stmt_case_constant(cond->left, &value))
+        other = cond->right;
+    else
+        return 0;
+    if (stmt_case_constant(other, 0) || expr_has_side_effects(other) || *count == STMT_SWITCH_MAX_CASES)
+        return 0;
+    if (!*subject)
+        *subject = other;
+    else if (!expr_equal(*subject, other))
+        return 0;
+    cases[*count].value = value;
+    cases[*count].order = *count;
+    cases[*count].body = body;
+    (*count)++;
+    return 1;
+}
+
+void stmt_codegen_decision(struct stmt_case *cases, int count, const char *reg, int *labels, int fallback, FILE *outfile)
+{ // binary search over sorted cases, a few at the leaves are tested one after the other
+    if (count <= STMT_SWITCH_LINEAR)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            fprintf(outfile, "\tCMPQ $%li, %s\n", cases[i].value, reg);
+            fprintf(outfile, "\tJE %s\n", label_name(labels[cases[i].body]));
+        }
+        fprintf(outfile, "\tJMP %s\n", label_name(fallback));
+        return;
+    }
+    int middle = count / 2;
+    int lower = label_create();
+    fprintf(outfile, "\tCMPQ $%li, %s\n", cases[middle].value, reg);
+    fprintf(outfile, "\tJE %s\n", label_name(labels[cases[middle].body]));
+    fprintf(outfile, "\tJL %s\n", label_name(lower));
+    stmt_codegen_decision(cases + middle + 1, count - middle - 1, reg, labels, fallback, outfile);
+    fprintf(outfile, "%s:\n", label_name(lower));
+    stmt_codegen_decision(cases, middle, reg, labels, fallback, outfile);
+}
+
+int stmt_codegen_switch(struct stmt *s, FILE *outfile)
+{ // dispatches an if/else-if chain comparing one expression with literals through a table or a binary search,
+  // returns 0 without emitting anything when s is not such a chain
+    struct stmt_case cases[STMT_SWITCH_MAX_CASES];
+    struct stmt *bodies[STMT_SWITCH_MAX_CASES];
+    struct expr *subject = 0;
+    struct stmt *arm = s;
+    struct stmt *fallback;
+    int count = 0;
+    int nbodies = 0;
+
+    for (;;)
+    {
+        int before = count;
+        if (nbodies == STMT_SWITCH_MAX_CASES || !stmt_case_values(arm->expr, &subject, cases, &count, nbodies))
+        { // the rest of the chain is compiled as it is
+            count = before;
+            fallback = arm;
+            break;
+        }
+        bodies[nbodies++] = arm->body;
+        fallback = arm->else_body;
+        while (fallback && fallback->kind == STMT_BLOCK && !fallback->next && fallback->body && fallback->body->kind == STMT_IF_ELSE && !fallback->body->next)
+            fallback = fallback->body; // else { if ... }
+        if (!fallback || fallback->kind != STMT_IF_ELSE || fallback->next)
+            break;
+        arm = fallback;
+    }
+    if (!nbodies || expr_need(subject) > scratch_available())
+        return 0;
+
+    // only the first test of each value can succeed
+    qsort(cases, count, sizeof(*cases), stmt_case_compare);
+    int distinct = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (!distinct || cases[i].value != cases[distinct - 1].value)
+            cases[distinct++] = cases[i];
+    }
+    if (distinct < STMT_SWITCH_MIN_CASES)
+        return 0;
+
+    int labels[STMT_SWITCH_MAX_CASES];
+    for (int i = 0; i < nbodies; i++)
+        labels[i] = label_create();
+    int default_label = label_create();
+    int done_label = label_create();
+
+    expr_codegen(subject, outfile);
+    const char *reg = scratch_name(subject->reg);
+    long low = cases[0].value;
+    long span = cases[distinct - 1].value - low + 1;
+    if (span <= STMT_SWITCH_MAX_TABLE && span <= (long)distinct * STMT_SWITCH_DENSITY)
+    { // one unsigned comparison rules out both sides of the table
+        int table = label_create();
+        if (low)
+            fprintf(outfile, "\tSUBQ $%li, %s\n", low, reg);
+        fprintf(outfile, "\tCMPQ $%li, %s\n", span - 1, reg);
+        fprintf(outfile, "\tJA %s\n", label_name(default_label));
+        fprintf(outfile, "\tJMP *%s(, %s, 8)\n", label_name(table), reg);
+        fprintf(outfile, "\t.pushsection .rodata\n");
+        fprintf(outfile, "\t.p2align 3\n");
+        fprintf(outfile, "%s:\n", label_name(table));
+        for (int i = 0, v = 0; v < span; v++)
+        {
+            int target = default_label;
+            if (i < distinct && cases[i].value == low + v)
+                target = labels[cases[i++].body];
+            fprintf(outfile, "\t.quad %s\n", label_name(target));
+        }
+        fprintf(outfile, "\t.popsection\n");
+    }
+    else
+    {
+        stmt_codegen_decision(cases, distinct, reg, labels, default_label, outfile);
+    }
+    scratch_free(subject->reg);
+
+    for (int i = 0; i < nbodies; i++)
+    {
+        fprintf(outfile, "%s:\n", label_name(labels[i]));
+        stmt_codegen(bodies[i], outfile);
+        fprintf(outfile, "\tJMP %s\n", label_name(done_label));
+    }
+    fprintf(outfile, "%s:\n", label_name(default_label));
+    stmt_codegen(fallback, outfile);
+    fprintf(outfile, "%s:\n", label_name(done_label));
+    return 1;
+}
+
+void stmt_codegen_print(struct expr *first, struct expr *end, FILE *outfile)
+{ // one print_items call for the items from first up to end: constant items are folded into the
+  // descriptor string, every other item is evaluated into a slot of an argument block on the stack
+    struct expr* pointer;
+    int nargs = 0;
+    for (pointer = first; pointer != end; pointer = pointer->next) {
+        if (!expr_print_constant(pointer)) nargs++;
+    }
+    int blocksize = (nargs * 8 + 15) / 16 * 16; // keeps the stack 16 byte aligned
+
+    int desclabel = label_create();
+    fprintf(outfile, "\t.pushsection .data\n");
+    fprintf(outfile, "%s:\n\t.string \"", label_name(desclabel));
+    for (pointer = first; pointer != end; pointer = pointer->next) {
+        expr_print_descriptor(pointer, outfile);
+    }
+    fprintf(outfile, "\"\n");
+    fprintf(outfile, "\t.popsection\n");
+
+    if (blocksize) {
+        fprintf(outfile, "\tSUBQ $%i, %%rsp\n", blocksize);
+        stack_depth += blocksize;
+    }
+    int slot = 0;
+    for (pointer = first; pointer != end; pointer = pointer->next) {
+        if (expr_print_constant(pointer)) continue;
+        expr_codegen(pointer, outfile);
+        fprintf(outfile, "\tMOVQ %s, %i(%%rsp)\n", scratch_name(pointer->reg), slot * 8);
+        scratch_free(pointer->reg);
+        slot++;
+    }
+
+    fprintf(outfile, "\tLEAQ %s, %%rdi\n", label_name(desclabel));
+    fprintf(outfile, "\tMOVQ %%rsp, %%rsi\n"); // the argument block
+    scratch_call("print_items", outfile);
+    if (blocksize) {
+        fprintf(outfile, "\tADDQ $%i, %%rsp\n", blocksize);
+        stack_depth -= blocksize;
+    }
+}
+
 void stmt_codegen(struct stmt *s, FILE *outfile)
 {
     if (!s) return;
@@ -286,44 +567,23 @@ void stmt_codegen(struct stmt *s, FILE *outfile)
     {
     case STMT_BLOCK: // do nothing but 
         stmt_codegen(s->body, outfile);
+        break;
     case STMT_PRINT:
         ;;
-        struct expr* pointer = s->expr;
-        while (pointer) {
-            fprintf(outfile, "\tPUSHQ %%r10\n");
-            fprintf(outfile, "\tPUSHQ %%r11\n");
-            fprintf(outfile, "\tPUSHQ %%rdi\n");
-
-            expr_codegen(pointer, outfile);
-            fprintf(outfile, "\tMOVQ %s, %%rdi\n", scratch_name(pointer->reg));
-
-            struct type *t = expr_typecheck(pointer);
-            switch (t->kind)
-            {
-            case TYPE_INTEGER:
-                fprintf(outfile, "\tCALL print_integer\n");
-                break;
-            case TYPE_BOOLEAN:
-                fprintf(outfile, "\tCALL print_boolean\n");
-                break;
-            case TYPE_STRING:
-                fprintf(outfile, "\tCALL print_string\n");
-                break;
-            case TYPE_CHARACTER:
-                fprintf(outfile, "\tCALL print_character\n");
-                break;
+        // items are printed in runs of one print_items call, and a new run starts at every item that may
+        // print or change a variable itself, so its effects still come after the items before it are printed
+        struct expr *first = s->expr;
+        if (!first) break;
+        for (struct expr *pointer = first->next; pointer; pointer = pointer->next) {
+            if (expr_has_side_effects(pointer)) {
+                stmt_codegen_print(first, pointer, outfile);
+                first = pointer;
             }
-
-            fprintf(outfile, "\tPOPQ %%rdi\n");
-            fprintf(outfile, "\tPOPQ %%r11\n");
-            fprintf(outfile, "\tPOPQ %%r10\n");            
-            scratch_free(pointer->reg);
-            if (pointer->next) {pointer = pointer->next;} else {break;}
         }
+        stmt_codegen_print(first, 0, outfile);
         break;
     case STMT_EXPR:
-        expr_codegen(s->expr, outfile);
-        scratch_free(s->expr->reg);
+        expr_codegen_effect(s->expr, outfile);
         break;
 
     case STMT_DECL:
@@ -332,25 +592,47 @@ void stmt_codegen(struct stmt *s, FILE *outfile)
 
     case STMT_RETURN:
         if (s->parent_function->type->kind != TYPE_VOID && s->expr->kind != TYPE_VOID) { // only print this stuff if non-void
-            expr_codegen(s->expr, outfile);
-            fprintf(outfile, "\tMOVQ %s, %%rax\n", scratch_name(s->expr->reg));
-            scratch_free(s->expr->reg);
+            if (expr_is_operand(s->expr)) {
+                fprintf(outfile, "\tMOVQ %s, %%rax\n", expr_operand(s->expr));
+            } else {
+                expr_codegen(s->expr, outfile);
+                fprintf(outfile, "\tMOVQ %s, %%rax\n", scratch_name(s->expr->reg));
+                scratch_free(s->expr->reg);
+            }
         }
         fprintf(outfile, "\tJMP .%s_epilogue\n", s->parent_function->name);
         break;
 
     case STMT_IF_ELSE:
-        if (s->else_body)
+        if (stmt_codegen_switch(s, outfile) || stmt_codegen_select(s, outfile)) {
+            break;
+        }
+        struct stmt* hot_arm = s->body;
+        struct stmt* cold_arm = s->else_body;
+        int cold_when = 0; // value of the condition that leads into cold_arm
+        if (layout_is_cold(s->body, outfile) && !layout_is_cold(s->else_body, outfile)) {
+            hot_arm = s->else_body;
+            cold_arm = s->body;
+            cold_when = 1;
+        }
+
+        if (layout_is_cold(cold_arm, outfile))
+        { // the cold arm goes out of line and the hot arm falls straight through
+            int cold_label = label_create();
+            int done_label = label_create();
+            expr_codegen_branch(s->expr, cold_label, cold_when, outfile);
+            stmt_codegen(hot_arm, outfile);
+            fprintf(outfile, "%s:\n", label_name(done_label));
+
+            fprintf(layout_cold, "%s:\n", label_name(cold_label));
+            stmt_codegen(cold_arm, layout_cold);
+            fprintf(layout_cold, "\tJMP %s\n", label_name(done_label));
+        }
+        else if (s->else_body)
         {
             int else_label = label_create();
             int done_label = label_create();
-            expr_codegen(s->expr, outfile);
-            int tempif = scratch_alloc();
-            fprintf(outfile, "\tMOVQ $0, %s\n", scratch_name(tempif));
-            fprintf(outfile, "\tCMP %s, %s\n", scratch_name(s->expr->reg), scratch_name(tempif));
-            scratch_free(s->expr->reg);
-            scratch_free(tempif);
-            fprintf(outfile, "\tJE %s\n", label_name(else_label));
+            expr_codegen_branch(s->expr, else_label, 0, outfile);
             stmt_codegen(s->body, outfile);
             fprintf(outfile, "\tJMP %s\n", label_name(done_label));
             fprintf(outfile, "%s:\n", label_name(else_label));
@@ -360,43 +642,39 @@ void stmt_codegen(struct stmt *s, FILE *outfile)
         else
         {
             int done_label = label_create();
-            expr_codegen(s->expr, outfile);
-            int tempelse = scratch_alloc();
-            fprintf(outfile, "\tMOVQ $0, %s\n", scratch_name(tempelse));
-            fprintf(outfile, "\tCMP %s, %s\n", scratch_name(s->expr->reg), scratch_name(tempelse));
-            scratch_free(s->expr->reg);
-            scratch_free(tempelse);
+            expr_codegen_branch(s->expr, done_label, 0, outfile);
             stmt_codegen(s->body, outfile);
-            fprintf(outfile, "\tJMP %s\n", label_name(done_label));
             fprintf(outfile, "%s:\n", label_name(done_label));
         }
         break;
     case STMT_FOR:
         ;;
+        // rotated into a guarded do-while: one test on entry, then one conditional branch back per iteration
         int top_label = label_create();
         int done_label = label_create();
-        
+
         if (s->init_expr) {
-            expr_codegen(s->init_expr, outfile);
-            scratch_free(s->init_expr->reg);
+            expr_codegen_effect(s->init_expr, outfile);
         }
-        fprintf(outfile, "%s:\n", label_name(top_label));
+        struct promote_loop* globals = promote_begin(s, outfile); // globals the loop keeps in registers
+        struct induct_loop* cursors = induct_begin(s, outfile); // array addresses that follow the counter
         if (s->expr) {
-            expr_codegen(s->expr, outfile);
-            int zero_register = scratch_alloc();
-            fprintf(outfile, "\tMOVQ $0, %s\n", scratch_name(zero_register));
-            fprintf(outfile, "\tCMP %s, %s\n", scratch_name(s->expr->reg), scratch_name(zero_register));
-            scratch_free(s->expr->reg);
-            scratch_free(zero_register);
+            induct_branch(cursors, s->expr, done_label, 0, outfile);
         }
-        fprintf(outfile, "\tJE %s\n", label_name(done_label));
+        fprintf(outfile, "\t.p2align 4,,10\n"); // loop heads start on a fetch block when it is cheap to pad
+        fprintf(outfile, "%s:\n", label_name(top_label));
+        layout_loop_depth++;
         stmt_codegen(s->body, outfile);
-        if (s->next_expr) {
-            expr_codegen(s->next_expr, outfile);
+        layout_loop_depth--;
+        induct_step(cursors, s->next_expr, outfile);
+        if (s->expr) {
+            induct_branch(cursors, s->expr, top_label, 1, outfile);
+        } else {
+            fprintf(outfile, "\tJMP %s\n", label_name(top_label));
         }
-        fprintf(outfile, "\tJMP %s\n", label_name(top_label));
         fprintf(outfile, "%s:\n", label_name(done_label));
-        
+        induct_end(cursors);
+        promote_end(globals, outfile);
         break;
     }
     stmt_codegen(s->next, outfile);
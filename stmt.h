@@ -6,6 +6,17 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+/* largest expression, in tree nodes, an if-converted arm may compute */
+#define STMT_SELECT_SIZE 8
+
+/* if/else-if chains over literals: fewest cases worth dispatching, how sparse and large a jump table may be,
+   and how many cases a decision tree still tests one after the other */
+#define STMT_SWITCH_MIN_CASES 4
+#define STMT_SWITCH_MAX_CASES 256
+#define STMT_SWITCH_DENSITY 3
+#define STMT_SWITCH_MAX_TABLE 1024
+#define STMT_SWITCH_LINEAR 3
+
 typedef enum {
 	STMT_DECL,
 	STMT_EXPR,
@@ -30,12 +41,18 @@ struct stmt {
 
 struct stmt * stmt_create( stmt_t kind, struct decl *decl, struct expr *init_expr, struct expr *expr, struct expr *next_expr, struct stmt *body, struct stmt *else_body, struct stmt *next );
 void stmt_delete( struct stmt *s);
+struct stmt* stmt_copy(struct stmt* s);
+int stmt_size(struct stmt* s);
 void stmt_print( struct stmt *s, int indent );
 void stmt_resolve(struct stmt* s, int print);
 void stmt_typecheck(struct stmt* s);
 void stmt_return_typecheck(struct decl* d);
 void stmt_return_typecheck_recursive(struct stmt* s, struct decl* d);
 void stmt_codegen(struct stmt* s, FILE* outfile);
+struct expr* stmt_assignment(struct stmt* s);
+int stmt_codegen_select(struct stmt* s, FILE* outfile);
+int stmt_codegen_switch(struct stmt* s, FILE* outfile);
+void stmt_codegen_print(struct expr* first, struct expr* end, FILE* outfile);
 
 void stmt_return_assign(struct stmt* s, struct decl* d);
 
@@ -4,7 +4,7 @@
 
 
 struct symbol * symbol_create( symbol_t kind, struct type *type, char *name ) {
-    struct symbol* s = malloc(sizeof(*s));
+    struct symbol* s = calloc(1, sizeof(*s));
 
     s->kind = kind;
     s->type = type_copy(type);
@@ -16,6 +16,8 @@ struct symbol * symbol_create( symbol_t kind, struct type *type, char *name ) {
 struct symbol* symbol_copy(struct symbol* in) {
     struct symbol* s = symbol_create(in->kind, in->type, in->name);
     s->which = in->which;
+    s->offset = in->offset;
+    s->reg = in->reg;
 
     return s;
 }
@@ -27,9 +29,13 @@ const char* symbol_codegen(struct symbol* s) {
    // first examine scope of a symbol
    // Global variables: name in assembly is same as in source language - if there is a global variable var:integer, then symbol should return var
    // local variables and function parameters: return an address computation that yields the position of that local parameter on the stack
-   // Position 0 is at addr -8(%rbp), 1 is at -16(%rbp)
+   // the offsets come from the frame layout, see frame.c
 
-    char* str = malloc(sizeof(char)*10);
+    char* str = malloc(sizeof(char)*24);
+
+    if (s->reg) {
+        return strdup(s->reg);
+    }
 
     switch(s->kind) {
         case SYMBOL_GLOBAL:
@@ -37,8 +43,28 @@ const char* symbol_codegen(struct symbol* s) {
             break;
         case SYMBOL_PARAM: // use argument variables // works for second two
         case SYMBOL_LOCAL:
-            sprintf(str, "-%i(%%rbp)", s->which*8);
+            sprintf(str, "%i(%%rbp)", s->offset);
             return str;
             break;
    }
-}
\ No newline at end of file
+}
+
+int symbol_size(struct symbol* s) {
+    /*bytes the variable takes in memory, char and boolean locals are packed into one byte*/
+    if (s->kind == SYMBOL_LOCAL && (s->type->kind == TYPE_CHARACTER || s->type->kind == TYPE_BOOLEAN)) {
+        return 1;
+    }
+    return 8;
+}
+
+int symbol_element_size(struct symbol* s) {
+    /*bytes one element of array or string s takes, char and boolean elements are packed one to a byte*/
+    struct type* t = s->type;
+    if (t->kind == TYPE_STRING) {
+        return 1;
+    }
+    if (t->kind == TYPE_ARRAY && t->subtype && (t->subtype->kind == TYPE_CHARACTER || t->subtype->kind == TYPE_BOOLEAN)) {
+        return 1;
+    }
+    return 8;
+}
@@ -14,10 +14,14 @@ struct symbol {
 	struct type *type;
 	char *name;
 	int which;
+	int offset; // from %rbp, for parameters and locals
+	const char *reg; // register the variable lives in instead, if any
 };
 
 struct symbol* symbol_create( symbol_t kind, struct type *type, char *name );
 struct symbol* symbol_copy(struct symbol* in);
 const char* symbol_codegen(struct symbol* s);
+int symbol_size(struct symbol* s);
+int symbol_element_size(struct symbol* s);
 
 #endif
\ No newline at end of file
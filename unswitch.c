@@ -0,0 +1,153 @@
+#include "unswitch.h"
+#include "symbol.h"
+#include "type.h"
+#include "range.h"
+#include "frame.h"
+#include "induct.h"
+#include "eval.h"
+
+int unswitch_budget = 0; // nodes the current function may still grow by
+int unswitch_report = 0;
+const char *unswitch_function_name = 0;
+
+int unswitch_declares(struct stmt *s, struct symbol *sym)
+{ // true if sym is declared in s, so it starts afresh on every iteration
+    for (; s; s = s->next)
+    {
+        for (struct decl *d = s->decl; d; d = d->next)
+        {
+            if (d->symbol == sym)
+                return 1;
+        }
+        if (unswitch_declares(s->body, sym) || unswitch_declares(s->else_body, sym))
+            return 1;
+    }
+    return 0;
+}
+
+int unswitch_invariant(struct expr *e, struct stmt *loop, int calls)
+{ // true if e has the same value on every iteration of loop and can be computed before it even if the body would not get to it
+    if (!e)
+        return 1;
+    switch (e->kind)
+    {
+    case EXPR_ASSGN:
+    case EXPR_INCR:
+    case EXPR_DECR:
+    case EXPR_CALL:
+    case EXPR_ARRACC:
+    case EXPR_DIV:
+    case EXPR_MOD:
+    case EXPR_EXPO:
+    case EXPR_STRING_LITERAL:
+        return 0;
+    case EXPR_NAME:
+        if (!e->symbol || e->symbol->type->kind == TYPE_ARRAY || e->symbol->type->kind == TYPE_FUNCTION)
+            return 0;
+        if (e->symbol->kind == SYMBOL_GLOBAL && calls)
+            return 0; // the callee may change it
+        if (range_assigns(loop->init_expr, e->symbol) || range_assigns(loop->expr, e->symbol) || range_assigns(loop->next_expr, e->symbol))
+            return 0;
+        return !range_stmt_assigns(loop->body, e->symbol) && !unswitch_declares(loop->body, e->symbol);
+    }
+    return unswitch_invariant(e->left, loop, calls) && unswitch_invariant(e->right, loop, calls);
+}
+
+struct stmt *unswitch_find(struct stmt *s, struct stmt *loop, int calls)
+{ // first if statement anywhere in s whose condition loop does not change
+    for (; s; s = s->next)
+    {
+        if (s->kind == STMT_IF_ELSE && !eval_is_constant(s->expr) && unswitch_invariant(s->expr, loop, calls)) // range analysis folds constant ones
+            return s;
+        struct stmt *found = unswitch_find(s->body, loop, calls);
+        if (!found)
+            found = unswitch_find(s->else_body, loop, calls);
+        if (found)
+            return found;
+    }
+    return 0;
+}
+
+void unswitch_take(struct stmt *s, int arm)
+{ // the if statement becomes the arm the hoisted condition chose
+    s->kind = STMT_BLOCK;
+    s->body = arm ? s->body : s->else_body;
+    s->else_body = 0;
+    s->expr = 0;
+}
+
+int unswitch_loop(struct stmt *s)
+{ // turns for loop s into an if over two copies of it, each with one arm of an invariant if in the body
+    if (frame_expr_uses(s->init_expr, EXPR_CALL))
+        return 0; // it could change what the condition reads before the loop starts
+    int calls = induct_calls(s->body) || frame_expr_uses(s->expr, EXPR_CALL) || frame_expr_uses(s->next_expr, EXPR_CALL);
+    struct stmt *branch = unswitch_find(s->body, s, calls);
+    if (!branch)
+        return 0;
+    int size = stmt_size(s->body) + 1;
+    if (size > UNSWITCH_MAX_LOOP || size > unswitch_budget)
+        return 0;
+    unswitch_budget -= size;
+
+    struct stmt *next = s->next;
+    s->next = 0;
+    struct stmt *copy = stmt_copy(s);
+    struct stmt *loop = stmt_create(STMT_FOR, 0, s->init_expr, s->expr, s->next_expr, s->body, 0, 0);
+    unswitch_take(unswitch_find(copy->body, copy, calls), 0); // the copy is searched the same way and finds the same if
+    struct expr *cond = branch->expr;
+    unswitch_take(branch, 1);
+
+    s->kind = STMT_IF_ELSE;
+    s->init_expr = 0;
+    s->expr = cond;
+    s->next_expr = 0;
+    s->body = loop;
+    s->else_body = copy;
+    s->next = next;
+    if (unswitch_report)
+        fprintf(stderr, "unswitch: loop in %s split on a condition it does not change\n", unswitch_function_name);
+    return 1;
+}
+
+void unswitch_stmt(struct stmt *s)
+{
+    for (; s; s = s->next)
+    {
+        switch (s->kind)
+        {
+        case STMT_FOR:
+            if (unswitch_loop(s))
+            { // each copy may have another condition to split on
+                unswitch_stmt(s->body);
+                unswitch_stmt(s->else_body);
+            }
+            else
+            {
+                unswitch_stmt(s->body);
+            }
+            break;
+        case STMT_IF_ELSE:
+        case STMT_BLOCK:
+            unswitch_stmt(s->body);
+            unswitch_stmt(s->else_body);
+            break;
+        }
+    }
+}
+
+void unswitch_function(struct decl *d, int report)
+{ // moves conditions that do not change inside a loop out of it, as far as the code growth budget allows
+    unswitch_budget = UNSWITCH_BUDGET;
+    unswitch_report = report;
+    unswitch_function_name = d->name;
+    unswitch_stmt(d->code);
+}
+
+void unswitch_program(struct decl *program, int report)
+{
+    for (struct decl *d = program; d; d = d->next)
+    {
+        if (d->type->kind == TYPE_FUNCTION && d->code)
+            unswitch_function(d, report);
+    }
+}
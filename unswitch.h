@@ -0,0 +1,19 @@
+#ifndef UNSWITCH_H
+#define UNSWITCH_H
+
+#include "decl.h"
+#include "stmt.h"
+#include "expr.h"
+
+/* largest loop, in statement and expression nodes, copied for one condition, and the nodes all copies in a function may add */
+#define UNSWITCH_MAX_LOOP 128
+#define UNSWITCH_BUDGET 512
+
+int unswitch_invariant(struct expr *e, struct stmt *loop, int calls);
+struct stmt *unswitch_find(struct stmt *s, struct stmt *loop, int calls);
+int unswitch_loop(struct stmt *s);
+void unswitch_stmt(struct stmt *s);
+void unswitch_function(struct decl *d, int report);
+void unswitch_program(struct decl *program, int report);
+
+#endif